@@ -1,9 +1,14 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "TLua.h"
+#include "Misc/Parse.h"
 #include "Misc/Paths.h"
 
 #include "TLua.hpp"
+#include "TLuaBench.hpp"
+#include "TLuaBytecode.hpp"
+#include "TLuaMemory.hpp"
+#include "TLuaProfiler.hpp"
 #include "CoreMinimal.h"
 
 #define LOCTEXT_NAMESPACE "FTLuaModule"
@@ -17,8 +22,6 @@ void FTLuaModule::StartupModule()
 
 void FTLuaModule::InitLua()
 {
-	TLua::Init();
-
 	TArray<FString> dirs;
 	dirs.Add(TEXT("")); // current dir
 	dirs.Add(TEXT("Libs/"));
@@ -27,16 +30,23 @@ void FTLuaModule::InitLua()
 	dirs.Add(TEXT("Game/"));
 
 	FString root = FPaths::ProjectContentDir() / TEXT("Script/Lua/");
+
+	// compile the scripts of the last startup on the worker threads, the loads below only undump them
+	TLua::BytecodeCache::Get().Prepare();
+
+	TLua::Init();
 	TLua::Call("_init_sys", root, dirs);
 
 	FString initFileName = FPaths::ProjectContentDir() / TEXT("Script/Lua/init.lua");
 	TLua::DoFile(initFileName);
 
 	TLua::Call("init");
+	TLua::BytecodeCache::Get().ReleasePrepared();
 }
 
 void FTLuaModule::ShutdownModule()
 {
+	TLua::BytecodeCache::Get().Flush();
 }
 
 class FLuaProcessor : public FSelfRegisteringExec
@@ -49,6 +59,27 @@ class FLuaProcessor : public FSelfRegisteringExec
 			return false;
 		}
 
+		// lua mem ..., lua profile ..., lua bytecode ..., lua bench ..., handled on the cpp side
+		const TCHAR* Args = Cmd;
+		if (FParse::Command(&Args, TEXT("lua"))) {
+			if (FParse::Command(&Args, TEXT("mem"))) {
+				TLua::ExecMemoryCommand(TLua::GetLuaState(), Args, Ar);
+				return true;
+			}
+			if (FParse::Command(&Args, TEXT("profile"))) {
+				TLua::ExecProfilerCommand(TLua::GetLuaState(), Args, Ar);
+				return true;
+			}
+			if (FParse::Command(&Args, TEXT("bytecode"))) {
+				TLua::ExecBytecodeCommand(Args, Ar);
+				return true;
+			}
+			if (FParse::Command(&Args, TEXT("bench"))) {
+				TLua::ExecBenchCommand(TLua::GetLuaState(), Args, Ar);
+				return true;
+			}
+		}
+
 		// send the command line to string
 		TLua::Call("_lua_process_console_command", FullCommand);
 		return true;
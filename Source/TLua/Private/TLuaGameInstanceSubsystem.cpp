@@ -18,6 +18,7 @@ void UTLuaGameInstanceSubsystem::Initialize(FSubsystemCollectionBase& Collection
 void UTLuaGameInstanceSubsystem::Deinitialize()
 {
 	TLua::Call("game_exit");
+	Root->Deactivate();
 	Root->RemoveFromRoot();
 	Root = nullptr;
 }
@@ -1332,6 +1332,81 @@ void lua_setwarnf (lua_State *L, lua_WarnFunction f, void *ud) {
 }
 
 
+/*
+** Return the contents of a short string, NULL for other values. Short
+** strings are interned, so the address identifies the string until the
+** string free function is called with it.
+*/
+LUA_API const char *lua_tointernedstring (lua_State *L, int idx,
+                                          size_t *len) {
+  const TValue *o;
+  const char *s = NULL;
+  lua_lock(L);
+  o = index2value(L, idx);
+  if (ttisshrstring(o)) {
+    s = getstr(tsvalue(o));
+    if (len != NULL)
+      *len = tsvalue(o)->shrlen;
+  }
+  lua_unlock(L);
+  return s;
+}
+
+
+void lua_setstringfreef (lua_State *L, lua_StringFreeFunction f, void *ud) {
+  lua_lock(L);
+  G(L)->ud_strfree = ud;
+  G(L)->strfreef = f;
+  lua_unlock(L);
+}
+
+
+static void countlist (GCObject *o, size_t *counts) {
+  for (; o != NULL; o = o->next) {
+    int t = novariant(o->tt);
+    if (t < LUA_NUMOBJECTTYPES)
+      counts[t]++;
+  }
+}
+
+
+/*
+** Count the collectable objects by the basic type, 'counts' has
+** LUA_NUMOBJECTTYPES entries (upvalues and prototypes at the end).
+** It walks all the objects, not for every frame.
+*/
+LUA_API void lua_countobjects (lua_State *L, size_t *counts) {
+  global_State *g;
+  int i;
+  lua_lock(L);
+  g = G(L);
+  for (i = 0; i < LUA_NUMOBJECTTYPES; i++)
+    counts[i] = 0;
+  countlist(g->allgc, counts);
+  countlist(g->finobj, counts);
+  countlist(g->tobefnz, counts);
+  countlist(g->fixedgc, counts);
+  lua_unlock(L);
+}
+
+
+LUA_API lua_Integer lua_getgcdebt (lua_State *L) {
+  lua_Integer debt;
+  lua_lock(L);
+  debt = cast(lua_Integer, G(L)->GCdebt);
+  lua_unlock(L);
+  return debt;
+}
+
+
+void lua_setallocsamplef (lua_State *L, lua_AllocSampleFunction f, void *ud) {
+  lua_lock(L);
+  G(L)->ud_allocsample = ud;
+  G(L)->allocsamplef = f;
+  lua_unlock(L);
+}
+
+
 void lua_warning (lua_State *L, const char *msg, int tocont) {
   lua_lock(L);
   luaE_warning(L, msg, tocont);
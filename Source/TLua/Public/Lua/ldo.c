@@ -231,6 +231,8 @@ int luaD_reallocstack (lua_State *L, int newsize, int raiseerror) {
   L->stack_last.p = L->stack.p + newsize;
   for (i = oldsize + EXTRA_STACK; i < newsize + EXTRA_STACK; i++)
     setnilvalue(s2v(newstack + i)); /* erase new segment */
+  if (newsize > oldsize)  /* sample the growth with the pointers corrected */
+    luaM_sample_(L, cast_sizet(newsize - oldsize) * sizeof(StackValue));
   return 1;
 }
 
@@ -800,6 +800,9 @@ static void freeobj (lua_State *L, GCObject *o) {
     }
     case LUA_VSHRSTR: {
       TString *ts = gco2ts(o);
+      global_State *g = G(L);
+      if (g->strfreef)  /* someone caches the address of the string? */
+        g->strfreef(g->ud_strfree, getstr(ts));
       luaS_remove(L, ts);  /* remove it from hash table */
       luaM_freemem(L, ts, sizelstring(ts->shrlen));
       break;
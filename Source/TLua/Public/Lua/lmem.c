@@ -185,6 +185,10 @@ void *luaM_realloc_ (lua_State *L, void *block, size_t osize, size_t nsize) {
   }
   lua_assert((nsize == 0) == (newblock == NULL));
   g->GCdebt = (g->GCdebt + nsize) - osize;
+  /* the growth of tables, vectors and buffers; the stack is reallocated
+     with 'gcstopem' set and its pointers broken, it samples by itself */
+  if (nsize > osize && !g->gcstopem)
+    luaM_sample_(L, nsize - osize);
   return newblock;
 }
 
@@ -210,6 +214,17 @@ void *luaM_malloc_ (lua_State *L, size_t size, int tag) {
         luaM_error(L);
     }
     g->GCdebt += size;
+    luaM_sample_(L, size);
     return newblock;
   }
 }
+
+
+/*
+** Report the new bytes to the allocation sampler, if any.
+*/
+void luaM_sample_ (lua_State *L, size_t size) {
+  global_State *g = G(L);
+  if (l_unlikely(g->allocsamplef))
+    g->allocsamplef(g->ud_allocsample, L, size);
+}
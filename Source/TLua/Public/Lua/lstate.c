@@ -376,6 +376,10 @@ LUA_API lua_State *lua_newstate (lua_Alloc f, void *ud) {
   g->ud = ud;
   g->warnf = NULL;
   g->ud_warn = NULL;
+  g->strfreef = NULL;
+  g->ud_strfree = NULL;
+  g->allocsamplef = NULL;
+  g->ud_allocsample = NULL;
   g->mainthread = L;
   g->seed = luai_makeseed(L);
   g->gcstp = GCSTPGC;  /* no GC while building state */
@@ -300,6 +300,10 @@ typedef struct global_State {
   TString *strcache[STRCACHE_N][STRCACHE_M];  /* cache for strings in API */
   lua_WarnFunction warnf;  /* warning function */
   void *ud_warn;         /* auxiliary data to 'warnf' */
+  lua_StringFreeFunction strfreef;  /* called when a short string is freed */
+  void *ud_strfree;         /* auxiliary data to 'strfreef' */
+  lua_AllocSampleFunction allocsamplef;  /* called for each new block */
+  void *ud_allocsample;         /* auxiliary data to 'allocsamplef' */
 } global_State;
 
 
@@ -131,6 +131,22 @@ typedef void * (*lua_Alloc) (void *ud, void *ptr, size_t osize, size_t nsize);
 typedef void (*lua_WarnFunction) (void *ud, const char *msg, int tocont);
 
 
+/*
+** Type for functions called when a short (interned) string is freed
+*/
+typedef void (*lua_StringFreeFunction) (void *ud, const char *s);
+
+
+/*
+** Type for functions called when the state allocates a new block or
+** grows one (tables, vectors, the stack), 'size' is the new bytes
+*/
+typedef void (*lua_AllocSampleFunction) (void *ud, lua_State *L, size_t size);
+
+/* basic types, upvalues and prototypes */
+#define LUA_NUMOBJECTTYPES	(LUA_NUMTYPES + 2)
+
+
 /*
 ** Type used by the debug API to collect debug information
 */
@@ -323,6 +339,24 @@ LUA_API void (lua_setwarnf) (lua_State *L, lua_WarnFunction f, void *ud);
 LUA_API void (lua_warning)  (lua_State *L, const char *msg, int tocont);
 
 
+/*
+** Interned string functions (TLua)
+*/
+LUA_API const char *(lua_tointernedstring) (lua_State *L, int idx,
+                                            size_t *len);
+LUA_API void (lua_setstringfreef) (lua_State *L, lua_StringFreeFunction f,
+                                   void *ud);
+
+
+/*
+** Memory inspection functions (TLua)
+*/
+LUA_API void (lua_countobjects) (lua_State *L, size_t *counts);
+LUA_API lua_Integer (lua_getgcdebt) (lua_State *L);
+LUA_API void (lua_setallocsamplef) (lua_State *L, lua_AllocSampleFunction f,
+                                    void *ud);
+
+
 /*
 ** garbage-collection function and options
 */
@@ -0,0 +1,219 @@
+#include "TLuaAllocator.hpp"
+
+namespace TLua
+{
+	const int32 LuaAllocator::ClassSizes[ClassNum] = {
+		8, 16, 24, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256
+	};
+
+	// [(Size + 7) / 8] = the smallest class fits the size
+	const uint8 LuaAllocator::SizeToClass[MaxSmallSize / 8 + 1] = {
+		0, 0, 1, 2, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9,
+		10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 13
+	};
+
+	LuaAllocator& LuaAllocator::Get()
+	{
+		static LuaAllocator Instance;
+		return Instance;
+	}
+
+	void* LuaAllocator::Alloc(void* UserData, void* Ptr, size_t OldSize, size_t NewSize)
+	{
+		LuaAllocator* Allocator = (LuaAllocator*)UserData;
+
+		// the OldSize of the new block is the type of the object
+		if (!Ptr) {
+			return NewSize ? Allocator->Malloc(NewSize) : nullptr;
+		}
+
+		if (NewSize == 0) {
+			Allocator->Free(Ptr, OldSize);
+			return nullptr;
+		}
+
+		return Allocator->Realloc(Ptr, OldSize, NewSize);
+	}
+
+	LuaAllocator::LuaAllocator()
+		: Total(0), Peak(0), Large(0), LargeBlocks(0), SoftLimit(0), bOverLimit(false)
+	{
+		for (int32 Index = 0; Index < ClassNum; ++Index) {
+			Pools[Index] = Pool{ ClassSizes[Index], nullptr, 0, 0, 0 };
+		}
+	}
+
+	LuaAllocator::~LuaAllocator()
+	{
+		for (void* Page : Pages) {
+			FMemory::Free(Page);
+		}
+	}
+
+	void LuaAllocator::SetSoftLimit(SIZE_T Limit, TFunction<void(SIZE_T Total)> Callback)
+	{
+		SoftLimit = Limit;
+		OnSoftLimit = MoveTemp(Callback);
+		bOverLimit = false;
+	}
+
+	LuaAllocatorStats LuaAllocator::GetStats() const
+	{
+		LuaAllocatorStats Stats;
+		Stats.Total = Total;
+		Stats.Peak = Peak;
+		Stats.Large = Large;
+		Stats.LargeBlocks = LargeBlocks;
+		Stats.Reserved = (SIZE_T)Pages.Num() * PageSize + Large;
+
+		for (const Pool& Each : Pools) {
+			LuaAllocatorStats::SizeClass& Class = Stats.Classes.AddDefaulted_GetRef();
+			Class.Size = Each.Size;
+			Class.Blocks = Each.Blocks;
+			Class.Allocs = Each.Allocs;
+			Class.Pages = Each.Pages;
+		}
+		return Stats;
+	}
+
+	int32 LuaAllocator::Trim()
+	{
+		int32 Released = 0;
+		for (Pool& Target : Pools) {
+			if (Target.Pages == 0 || !Target.FreeList) {
+				continue;
+			}
+
+			// count the free blocks of every page
+			TMap<uint8*, int32> FreeBlocks;
+			for (FreeBlock* Block = Target.FreeList; Block; Block = Block->Next) {
+				++FreeBlocks.FindOrAdd(GetPage(Block));
+			}
+
+			int32 BlocksPerPage = PageSize / Target.Size;
+			TSet<uint8*> Empty;
+			for (const auto& Pair : FreeBlocks) {
+				if (Pair.Value == BlocksPerPage) {
+					Empty.Add(Pair.Key);
+				}
+			}
+			if (Empty.Num() == 0) {
+				continue;
+			}
+
+			// unlink the blocks of the empty pages
+			FreeBlock** Link = &Target.FreeList;
+			while (*Link) {
+				if (Empty.Contains(GetPage(*Link))) {
+					*Link = (*Link)->Next;
+				}
+				else {
+					Link = &(*Link)->Next;
+				}
+			}
+
+			Pages.RemoveAllSwap([&Empty](void* Page) { return Empty.Contains((uint8*)Page); });
+			for (uint8* Page : Empty) {
+				FMemory::Free(Page);
+			}
+			Target.Pages -= Empty.Num();
+			Released += Empty.Num();
+		}
+		return Released;
+	}
+
+	void* LuaAllocator::Malloc(size_t Size)
+	{
+		UpdateTotal(0, Size);
+
+		if (Size > MaxSmallSize) {
+			Large += Size;
+			++LargeBlocks;
+			return FMemory::Malloc(Size);
+		}
+
+		Pool& Target = Pools[GetClass(Size)];
+		if (!Target.FreeList) {
+			AddPage(Target);
+		}
+
+		FreeBlock* Block = Target.FreeList;
+		Target.FreeList = Block->Next;
+		++Target.Blocks;
+		++Target.Allocs;
+		return Block;
+	}
+
+	void LuaAllocator::Free(void* Ptr, size_t Size)
+	{
+		UpdateTotal(Size, 0);
+
+		if (Size > MaxSmallSize) {
+			Large -= Size;
+			--LargeBlocks;
+			FMemory::Free(Ptr);
+			return;
+		}
+
+		Pool& Target = Pools[GetClass(Size)];
+		FreeBlock* Block = (FreeBlock*)Ptr;
+		Block->Next = Target.FreeList;
+		Target.FreeList = Block;
+		--Target.Blocks;
+	}
+
+	void* LuaAllocator::Realloc(void* Ptr, size_t OldSize, size_t NewSize)
+	{
+		if (OldSize > MaxSmallSize && NewSize > MaxSmallSize) {
+			UpdateTotal(OldSize, NewSize);
+			Large = Large - OldSize + NewSize;
+			return FMemory::Realloc(Ptr, NewSize);
+		}
+
+		// the block still fits the size class
+		if (OldSize <= MaxSmallSize && NewSize <= MaxSmallSize && GetClass(OldSize) == GetClass(NewSize)) {
+			UpdateTotal(OldSize, NewSize);
+			return Ptr;
+		}
+
+		void* NewPtr = Malloc(NewSize);
+		FMemory::Memcpy(NewPtr, Ptr, FMath::Min(OldSize, NewSize));
+		Free(Ptr, OldSize);
+		return NewPtr;
+	}
+
+	void LuaAllocator::AddPage(Pool& Target)
+	{
+		uint8* Page = (uint8*)FMemory::Malloc(PageSize, PageSize);
+		Pages.Add(Page);
+		++Target.Pages;
+
+		// link the blocks in address order
+		int32 Num = PageSize / Target.Size;
+		FreeBlock* Next = Target.FreeList;
+		for (int32 Index = Num - 1; Index >= 0; --Index) {
+			FreeBlock* Block = (FreeBlock*)(Page + Index * Target.Size);
+			Block->Next = Next;
+			Next = Block;
+		}
+		Target.FreeList = Next;
+	}
+
+	void LuaAllocator::UpdateTotal(size_t OldSize, size_t NewSize)
+	{
+		Total = Total - OldSize + NewSize;
+		Peak = FMath::Max(Peak, Total);
+
+		if (SoftLimit == 0) {
+			return;
+		}
+
+		bool bOver = Total > SoftLimit;
+		if (bOver != bOverLimit) {
+			bOverLimit = bOver;
+			if (bOver && OnSoftLimit) {
+				OnSoftLimit(Total);
+			}
+		}
+	}
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+
+// 1: the state allocates by the pooled LuaAllocator
+// 0: the realloc/free of lauxlib
+#ifndef TLUA_POOLED_ALLOCATOR
+#define TLUA_POOLED_ALLOCATOR 1
+#endif
+
+namespace TLua
+{
+	struct LuaAllocatorStats
+	{
+		struct SizeClass
+		{
+			int32 Size = 0;
+			int64 Blocks = 0;		// blocks in use
+			int64 Allocs = 0;		// allocations since the start
+			int32 Pages = 0;
+		};
+
+		TArray<SizeClass> Classes;
+		SIZE_T Total = 0;			// bytes requested by lua
+		SIZE_T Peak = 0;
+		SIZE_T Large = 0;			// bytes of the blocks from FMemory
+		int64 LargeBlocks = 0;
+		SIZE_T Reserved = 0;		// pages + large blocks
+	};
+
+	// lua_Alloc with the size class pools for the blocks <= MaxSmallSize,
+	// the larger blocks go to FMemory. one allocator per state, not thread safe.
+	// the pages are kept until Trim releases the fully free ones.
+	class TLua_API LuaAllocator
+	{
+	public:
+		static constexpr int32 MaxSmallSize = 256;
+		static constexpr int32 PageSize = 16 * 1024;
+		static constexpr int32 ClassNum = 14;
+
+		// the allocator of GetLuaState()
+		static LuaAllocator& Get();
+
+		// lua_Alloc, UserData is the LuaAllocator
+		static void* Alloc(void* UserData, void* Ptr, size_t OldSize, size_t NewSize);
+
+		LuaAllocator();
+		~LuaAllocator();
+
+		// the callback is called each time the heap grows over the limit, the
+		// allocation still succeeds. it runs inside the allocation, never call lua in it.
+		// 0 disables the limit
+		void SetSoftLimit(SIZE_T Limit, TFunction<void(SIZE_T Total)> Callback);
+
+		inline SIZE_T GetTotal() const
+		{
+			return Total;
+		}
+
+		LuaAllocatorStats GetStats() const;
+
+		// release the pages without a block in use, return the number of pages.
+		// it walks the free lists, call it after a full collection
+		int32 Trim();
+
+	private:
+		struct FreeBlock
+		{
+			FreeBlock* Next;
+		};
+
+		struct Pool
+		{
+			int32 Size;
+			FreeBlock* FreeList;
+			int64 Blocks;
+			int64 Allocs;
+			int32 Pages;
+		};
+
+		static inline int32 GetClass(size_t Size)
+		{
+			return SizeToClass[(Size + 7) >> 3];
+		}
+
+		// the pages are aligned to PageSize
+		static inline uint8* GetPage(const void* Block)
+		{
+			return (uint8*)((UPTRINT)Block & ~(UPTRINT)(PageSize - 1));
+		}
+
+		void* Malloc(size_t Size);
+		void Free(void* Ptr, size_t Size);
+		void* Realloc(void* Ptr, size_t OldSize, size_t NewSize);
+		void AddPage(Pool& Target);
+		void UpdateTotal(size_t OldSize, size_t NewSize);
+
+	private:
+		static const int32 ClassSizes[ClassNum];
+		static const uint8 SizeToClass[MaxSmallSize / 8 + 1];
+
+		Pool Pools[ClassNum];
+		TArray<void*> Pages;
+
+		SIZE_T Total;
+		SIZE_T Peak;
+		SIZE_T Large;
+		int64 LargeBlocks;
+
+		SIZE_T SoftLimit;
+		bool bOverLimit;
+		TFunction<void(SIZE_T)> OnSoftLimit;
+	};
+}
@@ -0,0 +1,175 @@
+#include "TLuaBench.hpp"
+
+#include "HAL/PlatformTime.h"
+#include "Kismet/KismetMathLibrary.h"
+#include "Misc/OutputDevice.h"
+#include "Misc/Parse.h"
+
+#include "TLua.hpp"
+#include "TLuaCppLua.hpp"
+#include "TLuaMemberCache.hpp"
+
+// the iterations of a benchmark without the count argument
+#define TLUA_BENCH_DEFAULT_COUNT 1000000
+
+namespace TLua
+{
+	// run Body Count times, log the time per iteration
+	template <typename Callable>
+	static double Measure(FOutputDevice& Ar, const TCHAR* Name, int32 Count, Callable&& Body)
+	{
+		double Start = FPlatformTime::Seconds();
+		for (int32 Index = 0; Index < Count; ++Index) {
+			Body(Index);
+		}
+		double Seconds = FPlatformTime::Seconds() - Start;
+
+		double Nanoseconds = Seconds * 1e9 / FMath::Max(Count, 1);
+		Ar.Logf(TEXT("  %-32s %8.1f ns, %.3f s total"), Name, Nanoseconds, Seconds);
+		return Nanoseconds;
+	}
+
+	static void LogSpeedup(FOutputDevice& Ar, double Base, double Fast)
+	{
+		Ar.Logf(TEXT("  speedup %.2fx"), Fast > 0.0 ? Base / Fast : 0.0);
+	}
+
+	// the same traceback the native handler of TLuaImp builds
+	static int BenchTraceHandler(lua_State* State)
+	{
+		luaL_traceback(State, State, lua_tostring(State, 1), 1);
+		return 1;
+	}
+
+	// the c++ -> lua call through the lua side trace_call against the native message handler
+	static void BenchCall(lua_State* State, int32 Count, FOutputDevice& Ar)
+	{
+		int Top = lua_gettop(State);
+
+		luaL_loadstring(State, "return function(Value) return Value end");
+		lua_call(State, 0, 1);
+		int Fun = lua_gettop(State);								// fun
+
+		// the project trace_call, or the same xpcall wrapper without it
+		if (lua_getglobal(State, TLUA_TRACE_CALL_NAME) != LUA_TFUNCTION) {
+			lua_pop(State, 1);
+			luaL_loadstring(State, "return function(Fun, ...) return xpcall(Fun, debug.traceback, ...) end");
+			lua_call(State, 0, 1);
+		}
+		int TraceCall = lua_gettop(State);							// fun, trace_call
+
+		lua_pushcfunction(State, BenchTraceHandler);
+		int Handler = lua_gettop(State);							// fun, trace_call, handler
+
+		Ar.Logf(TEXT("call: %d calls of function(Value) return Value end"), Count);
+		double Base = Measure(Ar, TEXT("trace_call(fun, value)"), Count, [&](int32 Index) {
+			lua_pushvalue(State, TraceCall);
+			lua_pushvalue(State, Fun);
+			lua_pushinteger(State, Index);
+			lua_pcall(State, 2, 0, 0);
+		});
+		double Fast = Measure(Ar, TEXT("pcall(fun, value), native msgh"), Count, [&](int32 Index) {
+			lua_pushvalue(State, Fun);
+			lua_pushinteger(State, Index);
+			lua_pcall(State, 1, 0, Handler);
+		});
+		LogSpeedup(Ar, Base, Fast);
+
+		lua_settop(State, Top);
+	}
+
+	// the scalar property read through the descriptor against the virtual processor
+	static void BenchPropertyRead(lua_State* State, UScriptStruct* Struct, const TCHAR* Member, int32 Count, FOutputDevice& Ar)
+	{
+		PropertyProcessor* Processor = MemberCache::Get().Find(Struct, FName(Member)).Processor;
+		if (!Processor) {
+			Ar.Logf(TEXT("property: no %s in %s"), Member, *Struct->GetName());
+			return;
+		}
+
+		uint8* Container = (uint8*)FMemory_Alloca_Aligned(Struct->GetStructureSize(), Struct->GetMinAlignment());
+		Struct->InitializeStruct(Container);
+
+		Ar.Logf(TEXT("property: %d reads of %s.%s (%s)"), Count, *Struct->GetName(), Member, *Processor->Property->GetCPPType());
+		double Base = Measure(Ar, TEXT("virtual ToLuaImp"), Count, [&](int32 Index) {
+			Processor->ToLuaImp(State, Container);
+			lua_pop(State, 1);
+		});
+		double Fast = Measure(Ar, TEXT("descriptor ToLua"), Count, [&](int32 Index) {
+			Processor->ToLua(State, Container);
+			lua_pop(State, 1);
+		});
+		LogSpeedup(Ar, Base, Fast);
+
+		Struct->DestroyStruct(Container);
+	}
+
+	// the UFunction called by ProcessEvent against the direct native thunk call
+	static void BenchFunctionCall(UClass* Class, const TCHAR* Name, int32 Count, FOutputDevice& Ar)
+	{
+		FunctionContext* Context = MemberCache::Get().Find(Class, FName(Name)).Function;
+		if (!Context) {
+			// renamed between the engine versions
+			return;
+		}
+
+		UFunction* Function = Context->GetFunction();
+		if (!Context->IsNativeCall()) {
+			Ar.Logf(TEXT("function: %s is not called by the thunk"), Name);
+			return;
+		}
+
+		UObject* Object = Class->GetDefaultObject();
+		uint8* Parameters = (uint8*)FMemory_Alloca_Aligned(FMath::Max<int32>(Function->ParmsSize, 1), Function->GetMinAlignment());
+		Function->InitializeStruct(Parameters);
+
+		Ar.Logf(TEXT("function: %d calls of %s::%s"), Count, *Class->GetName(), Name);
+		double Base = Measure(Ar, TEXT("ProcessEvent"), Count, [&](int32 Index) {
+			Object->ProcessEvent(Function, Parameters);
+		});
+		double Fast = Measure(Ar, TEXT("native thunk"), Count, [&](int32 Index) {
+			Context->CallNative(Object, Parameters);
+		});
+		LogSpeedup(Ar, Base, Fast);
+
+		Function->DestroyStruct(Parameters);
+	}
+
+	void ExecBenchCommand(lua_State* State, const TCHAR* Cmd, FOutputDevice& Ar)
+	{
+		FString Name = FParse::Token(Cmd, false);
+		FString CountToken = FParse::Token(Cmd, false);
+		// lua bench <count> runs all of them
+		if (Name.IsNumeric()) {
+			CountToken = Name;
+			Name.Reset();
+		}
+		int32 Count = CountToken.IsEmpty() ? TLUA_BENCH_DEFAULT_COUNT : FMath::Max(FCString::Atoi(*CountToken), 1);
+
+		bool bAll = Name.IsEmpty();
+		bool bFound = false;
+		if (bAll || Name == TEXT("call")) {
+			BenchCall(State, Count, Ar);
+			bFound = true;
+		}
+		if (bAll || Name == TEXT("property")) {
+			BenchPropertyRead(State, TBaseStructure<FLinearColor>::Get(), TEXT("R"), Count, Ar);
+			BenchPropertyRead(State, TBaseStructure<FIntPoint>::Get(), TEXT("X"), Count, Ar);
+			bFound = true;
+		}
+		if (bAll || Name == TEXT("function")) {
+			static const TCHAR* MathFunctions[] = {
+				TEXT("Add_IntInt"), TEXT("Multiply_DoubleDouble"), TEXT("Multiply_FloatFloat"),
+				TEXT("Max"), TEXT("Sin"), TEXT("Add_VectorVector"), TEXT("VSize"),
+			};
+			for (const TCHAR* Function : MathFunctions) {
+				BenchFunctionCall(UKismetMathLibrary::StaticClass(), Function, Count, Ar);
+			}
+			bFound = true;
+		}
+
+		if (!bFound) {
+			Ar.Logf(TEXT("lua bench [call | property | function] [count]"));
+		}
+	}
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+
+namespace TLua
+{
+	// micro benchmarks of the hot paths, the numbers are logged per operation.
+	// lua bench [call | property | function] [count]
+	TLua_API void ExecBenchCommand(lua_State* State, const TCHAR* Cmd, FOutputDevice& Ar);
+}
@@ -30,19 +30,22 @@ public:
 	template <typename ...ArgTypes>
 	void TryCall(const char* Name, const ArgTypes&... Args)
 	{
-		TLua::Call("_lua_tcall", (void*)Owner, Name, Args...);
+		static TLua::FunctionHandle Handle("_lua_tcall");
+		Handle.Call((void*)Owner, Name, Args...);
 	}
 
 	template <typename ...ArgTypes>
 	void Call(const char* Name, const ArgTypes&... Args)
 	{
-		TLua::Call("_lua_call", (void*)Owner, Name, Args...);
+		static TLua::FunctionHandle Handle("_lua_call");
+		Handle.Call((void*)Owner, Name, Args...);
 	}
 
 	template <typename ReturnType, typename ...ArgTypes>
 	ReturnType RCall(const char* Name, const ArgTypes&... Args)
 	{
-		return TLua::RCall<ReturnType>("_lua_call", (void*)Owner, Name, Args...);
+		static TLua::FunctionHandle Handle("_lua_call");
+		return Handle.RCall<ReturnType>((void*)Owner, Name, Args...);
 	}
 
 private:
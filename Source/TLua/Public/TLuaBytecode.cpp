@@ -0,0 +1,377 @@
+#include "TLuaBytecode.hpp"
+
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Misc/SecureHash.h"
+
+#include "TLua.h"
+
+static int32 GBytecodeCache = UE_BUILD_SHIPPING ? 0 : 1;
+static FAutoConsoleVariableRef CVarBytecodeCache(
+	TEXT("tlua.bytecode.Cache"),
+	GBytecodeCache,
+	TEXT("1: load the scripts through the bytecode cache under Saved/TLua/Bytecode, 0: compile the source every time"));
+
+static int32 GBytecodePrepare = 1;
+static FAutoConsoleVariableRef CVarBytecodePrepare(
+	TEXT("tlua.bytecode.Prepare"),
+	GBytecodePrepare,
+	TEXT("1: compile the scripts loaded at the last startup on the worker threads"));
+
+namespace TLua
+{
+	// the cache file: header, lua_dump output
+	struct BytecodeHeader
+	{
+		uint8 Magic[4];
+		uint32 Version;
+		uint8 Hash[20];
+	};
+
+	static const uint8 BytecodeMagic[4] = { 'T', 'L', 'B', 'C' };
+
+	static FSHAHash HashSource(const uint8* Source, int32 Size, const char* ChunkName)
+	{
+		uint32 Version = LUA_VERSION_RELEASE_NUM;
+		FSHA1 Sha;
+		Sha.Update(Source, Size);
+		Sha.Update((const uint8*)ChunkName, FCStringAnsi::Strlen(ChunkName));
+		Sha.Update((const uint8*)&Version, sizeof(Version));
+		Sha.Final();
+
+		FSHAHash Hash;
+		Sha.GetHash(Hash.Hash);
+		return Hash;
+	}
+
+	static void InitHeader(TArray<uint8>& Data, const FSHAHash& Hash)
+	{
+		Data.AddUninitialized(sizeof(BytecodeHeader));
+		BytecodeHeader* Header = (BytecodeHeader*)Data.GetData();
+		FMemory::Memcpy(Header->Magic, BytecodeMagic, sizeof(BytecodeMagic));
+		Header->Version = LUA_VERSION_RELEASE_NUM;
+		FMemory::Memcpy(Header->Hash, Hash.Hash, sizeof(Hash.Hash));
+	}
+
+	static bool IsValidCache(const TArray<uint8>& Cached, const FSHAHash& Hash)
+	{
+		if (Cached.Num() <= (int32)sizeof(BytecodeHeader)) {
+			return false;
+		}
+
+		const BytecodeHeader* Header = (const BytecodeHeader*)Cached.GetData();
+		return FMemory::Memcmp(Header->Magic, BytecodeMagic, sizeof(BytecodeMagic)) == 0
+			&& Header->Version == LUA_VERSION_RELEASE_NUM
+			&& FMemory::Memcmp(Header->Hash, Hash.Hash, sizeof(Hash.Hash)) == 0;
+	}
+
+	static void SaveFileAtomic(const TArray<uint8>& Data, const FString& Path)
+	{
+		// a reader sees the old file or the new one, never a partial one
+		FString TempPath = Path + TEXT(".tmp");
+		if (FFileHelper::SaveArrayToFile(Data, *TempPath)) {
+			IFileManager::Get().Move(*Path, *TempPath, true, true);
+		}
+	}
+
+	static int WriteBytecode(lua_State* State, const void* Data, size_t Size, void* UserData)
+	{
+		((TArray<uint8>*)UserData)->Append((const uint8*)Data, Size);
+		return 0;
+	}
+
+	BytecodeCache& BytecodeCache::Get()
+	{
+		static BytecodeCache Cache;
+		return Cache;
+	}
+
+	BytecodeCache::BytecodeCache()
+		: CacheDir(FPaths::ProjectSavedDir() / TEXT("TLua/Bytecode")), bRecording(false)
+	{
+	}
+
+	FString BytecodeCache::GetCachePath(const FString& FullName) const
+	{
+		return CacheDir / FString::Printf(TEXT("%s-%08x.luac"), *FPaths::GetBaseFilename(FullName), FCrc::StrCrc32(*FullName));
+	}
+
+	FString BytecodeCache::GetManifestPath() const
+	{
+		return CacheDir / TEXT("Startup.txt");
+	}
+
+	bool BytecodeCache::Load(lua_State* State, const FString& FileName, const char* ChunkName)
+	{
+		FString FullName = FPaths::ConvertRelativePathToFull(FileName);
+		if (bRecording) {
+			StartupFiles.AddUnique(FString::Printf(TEXT("%s\t%s"), UTF8_TO_TCHAR(ChunkName), *FullName));
+		}
+		if (PreparedChunk* Chunk = Prepared.Find(FullName)) {
+			// the chunk name is saved in the bytecode, it must be the one of the caller
+			if (Chunk->ChunkName == UTF8_TO_TCHAR(ChunkName)) {
+				TArray<uint8> Bytecode = MoveTemp(Chunk->Bytecode);
+				Prepared.Remove(FullName);
+				if (luaL_loadbufferx(State, (const char*)Bytecode.GetData(), Bytecode.Num(), ChunkName, "b") == LUA_OK) {
+					++Stats.Prepared;
+					return true;
+				}
+				lua_pop(State, 1);
+			}
+		}
+
+		TArray<uint8> Source;
+		if (!FFileHelper::LoadFileToArray(Source, *FileName, FILEREAD_Silent)) {
+			return LoadCooked(State, FileName);
+		}
+
+		if (!GBytecodeCache) {
+			return luaL_loadbufferx(State, (const char*)Source.GetData(), Source.Num(), ChunkName, "bt") == LUA_OK;
+		}
+
+		FSHAHash Hash = HashSource(Source.GetData(), Source.Num(), ChunkName);
+		FString CachePath = GetCachePath(FullName);
+
+		TArray<uint8> Cached;
+		if (FFileHelper::LoadFileToArray(Cached, *CachePath, FILEREAD_Silent) && IsValidCache(Cached, Hash)) {
+			const char* Bytecode = (const char*)Cached.GetData() + sizeof(BytecodeHeader);
+			if (luaL_loadbufferx(State, Bytecode, Cached.Num() - sizeof(BytecodeHeader), ChunkName, "b") == LUA_OK) {
+				++Stats.Hits;
+				return true;
+			}
+			// the format of the build differs, rebuild it
+			lua_pop(State, 1);
+		}
+
+		++Stats.Misses;
+		if (luaL_loadbufferx(State, (const char*)Source.GetData(), Source.Num(), ChunkName, "bt") != LUA_OK) {
+			return false;
+		}
+
+		// the dump of the loaded function is cheap, only the file io goes to the background
+		TArray<uint8> Data;
+		InitHeader(Data, Hash);
+		if (lua_dump(State, WriteBytecode, &Data, 0) == 0) {
+			WriteAsync(MoveTemp(CachePath), MoveTemp(Data));
+		}
+		return true;
+	}
+
+	bool BytecodeCache::LoadCooked(lua_State* State, const FString& FileName)
+	{
+		TArray<uint8> Bytecode;
+		FString CookedName = FPaths::ChangeExtension(FileName, TEXT("luac"));
+		if (!FFileHelper::LoadFileToArray(Bytecode, *CookedName, FILEREAD_Silent)) {
+			FTCHARToUTF8 Name(*FileName);
+			lua_pushfstring(State, "cannot read %s", Name.Get());
+			return false;
+		}
+
+		// the chunk name is saved in the bytecode
+		++Stats.Cooked;
+		return luaL_loadbufferx(State, (const char*)Bytecode.GetData(), Bytecode.Num(), nullptr, "b") == LUA_OK;
+	}
+
+	bool BytecodeCache::Compile(const uint8* Source, int32 Size, const char* ChunkName,
+		TArray<uint8>& OutBytecode, FString& OutError, bool bStrip)
+	{
+		// no libs are needed by the parser
+		lua_State* State = luaL_newstate();
+		if (State == nullptr) {
+			OutError = TEXT("not enough memory");
+			return false;
+		}
+
+		bool bSuccess = luaL_loadbufferx(State, (const char*)Source, Size, ChunkName, "t") == LUA_OK;
+		if (bSuccess) {
+			bSuccess = lua_dump(State, WriteBytecode, &OutBytecode, bStrip ? 1 : 0) == 0;
+		}
+		else {
+			OutError = UTF8_TO_TCHAR(lua_tostring(State, -1));
+		}
+
+		lua_close(State);
+		return bSuccess;
+	}
+
+	int32 BytecodeCache::Cook(const FString& SourceDir, const FString& OutputDir, bool bStrip, FOutputDevice& Ar)
+	{
+		TArray<FString> Files;
+		IFileManager::Get().FindFilesRecursive(Files, *SourceDir, TEXT("*.lua"), true, false);
+
+		int32 Num = 0;
+		for (const FString& FileName : Files) {
+			TArray<uint8> Source;
+			if (!FFileHelper::LoadFileToArray(Source, *FileName, FILEREAD_Silent)) {
+				Ar.Logf(TEXT("lua bytecode: failed to read %s"), *FileName);
+				continue;
+			}
+
+			FTCHARToUTF8 ChunkName(*FPaths::GetCleanFilename(FileName));
+			TArray<uint8> Bytecode;
+			FString Error;
+			if (!Compile(Source.GetData(), Source.Num(), ChunkName.Get(), Bytecode, Error, bStrip)) {
+				Ar.Logf(TEXT("lua bytecode: %s"), *Error);
+				continue;
+			}
+
+			FString RelativeName = FileName;
+			FPaths::MakePathRelativeTo(RelativeName, *(SourceDir / TEXT("")));
+			FString CookedName = FPaths::ChangeExtension(OutputDir / RelativeName, TEXT("luac"));
+			if (!FFileHelper::SaveArrayToFile(Bytecode, *CookedName)) {
+				Ar.Logf(TEXT("lua bytecode: failed to write %s"), *CookedName);
+				continue;
+			}
+			++Num;
+		}
+		return Num;
+	}
+
+	void BytecodeCache::WriteAsync(FString Path, TArray<uint8> Data)
+	{
+		Writes.RemoveAll([](const UE::Tasks::FTask& Task) { return Task.IsCompleted(); });
+		++Stats.Writes;
+
+		Writes.Add(UE::Tasks::Launch(UE_SOURCE_LOCATION, [Path = MoveTemp(Path), Data = MoveTemp(Data)]() {
+			SaveFileAtomic(Data, Path);
+		}));
+	}
+
+	void BytecodeCache::Prepare()
+	{
+		// record the files loaded through the cache until ReleasePrepared
+		bRecording = true;
+		StartupFiles.Reset();
+		if (!GBytecodePrepare) {
+			return;
+		}
+
+		// the files loaded at the last startup, "chunk name\tfull path"
+		TArray<FString> Files;
+		TArray<FString> ChunkNames;
+		FFileHelper::LoadFileToStringArray(StartupManifest, *GetManifestPath());
+		for (const FString& Line : StartupManifest) {
+			FString ChunkName, FileName;
+			if (Line.Split(TEXT("\t"), &ChunkName, &FileName)) {
+				ChunkNames.Add(ChunkName);
+				Files.Add(FileName);
+			}
+		}
+
+		struct PrepareResult
+		{
+			TArray<uint8> Bytecode;
+			bool bHit = false;
+		};
+		TArray<PrepareResult> Results;
+		Results.SetNum(Files.Num());
+		bool bUseCache = GBytecodeCache != 0;
+
+		// the workers only touch their own result and files, the errors are reported by the load
+		ParallelFor(Files.Num(), [&](int32 Index) {
+			PrepareResult& Result = Results[Index];
+			TArray<uint8> Source;
+			if (!FFileHelper::LoadFileToArray(Source, *Files[Index], FILEREAD_Silent)) {
+				return;
+			}
+
+			FTCHARToUTF8 ChunkName(*ChunkNames[Index]);
+			FSHAHash Hash = HashSource(Source.GetData(), Source.Num(), ChunkName.Get());
+			FString CachePath = GetCachePath(Files[Index]);
+
+			TArray<uint8> Cached;
+			if (bUseCache && FFileHelper::LoadFileToArray(Cached, *CachePath, FILEREAD_Silent) && IsValidCache(Cached, Hash)) {
+				Result.Bytecode.Append(Cached.GetData() + sizeof(BytecodeHeader), Cached.Num() - sizeof(BytecodeHeader));
+				Result.bHit = true;
+				return;
+			}
+
+			TArray<uint8> Data;
+			FString Error;
+			InitHeader(Data, Hash);
+			if (!Compile(Source.GetData(), Source.Num(), ChunkName.Get(), Data, Error)) {
+				return;
+			}
+
+			if (bUseCache) {
+				SaveFileAtomic(Data, CachePath);
+			}
+			Result.Bytecode.Append(Data.GetData() + sizeof(BytecodeHeader), Data.Num() - sizeof(BytecodeHeader));
+		});
+
+		for (int32 Index = 0; Index < Files.Num(); ++Index) {
+			PrepareResult& Result = Results[Index];
+			if (Result.Bytecode.Num() == 0) {
+				continue;
+			}
+
+			if (Result.bHit) {
+				++Stats.Hits;
+			}
+			else {
+				++Stats.Misses;
+			}
+			PreparedChunk& Chunk = Prepared.Add(Files[Index]);
+			Chunk.ChunkName = ChunkNames[Index];
+			Chunk.Bytecode = MoveTemp(Result.Bytecode);
+		}
+	}
+
+	void BytecodeCache::ReleasePrepared()
+	{
+		Prepared.Empty();
+		if (!bRecording) {
+			return;
+		}
+		bRecording = false;
+
+		// prepare these files at the next startup
+		if (StartupFiles != StartupManifest) {
+			FFileHelper::SaveStringArrayToFile(StartupFiles, *GetManifestPath());
+		}
+		StartupFiles.Empty();
+		StartupManifest.Empty();
+	}
+
+	void BytecodeCache::Flush()
+	{
+		UE::Tasks::Wait(Writes);
+		Writes.Reset();
+	}
+
+	void BytecodeCache::Clear()
+	{
+		Flush();
+		IFileManager::Get().DeleteDirectory(*CacheDir, false, true);
+	}
+
+	void ExecBytecodeCommand(const TCHAR* Cmd, FOutputDevice& Ar)
+	{
+		BytecodeCache& Cache = BytecodeCache::Get();
+		if (FParse::Command(&Cmd, TEXT("cook"))) {
+			FString OutputDir = FParse::Token(Cmd, false);
+			if (OutputDir.IsEmpty()) {
+				OutputDir = FPaths::ProjectSavedDir() / TEXT("TLua/Cooked/Script/Lua");
+			}
+			bool bStrip = FParse::Command(&Cmd, TEXT("strip"));
+			FString SourceDir = FPaths::ProjectContentDir() / TEXT("Script/Lua");
+			int32 Num = Cache.Cook(SourceDir, OutputDir, bStrip, Ar);
+			Ar.Logf(TEXT("lua bytecode: %d files cooked to %s"), Num, *OutputDir);
+		}
+		else if (FParse::Command(&Cmd, TEXT("clear"))) {
+			Cache.Clear();
+		}
+		else if (FParse::Command(&Cmd, TEXT("flush"))) {
+			Cache.Flush();
+		}
+		else {
+			const BytecodeCacheStats& Stats = Cache.GetStats();
+			Ar.Logf(TEXT("lua bytecode: %lld hits, %lld misses, %lld prepared, %lld cooked, %lld writes"),
+				Stats.Hits, Stats.Misses, Stats.Prepared, Stats.Cooked, Stats.Writes);
+		}
+	}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "Tasks/Task.h"
+
+namespace TLua
+{
+	struct BytecodeCacheStats
+	{
+		int64 Hits = 0;			// loaded from Saved/TLua/Bytecode
+		int64 Misses = 0;		// compiled from the source, the cache file is rewritten
+		int64 Prepared = 0;		// undumped from the chunks compiled at startup
+		int64 Cooked = 0;		// no source, loaded from the cooked .luac
+		int64 Writes = 0;		// cache files written in the background
+	};
+
+	// the script chunks are cached as bytecode under Saved/TLua/Bytecode, keyed by
+	// the sha1 of the source, the chunk name and the lua version. the stale files
+	// are rebuilt in the background. without the source (bytecode only paks) the
+	// cooked file next to it (foo.lua -> foo.luac) is loaded.
+	// at startup Prepare compiles the files loaded through the cache at the last
+	// startup on the worker threads, the loads on the game thread only undump them.
+	class TLua_API BytecodeCache
+	{
+	public:
+		static BytecodeCache& Get();
+
+		// push the main function of the file, or the error message and return false
+		bool Load(lua_State* State, const FString& FileName, const char* ChunkName);
+
+		// compile the source to bytecode in a throwaway state, safe on any thread
+		static bool Compile(const uint8* Source, int32 Size, const char* ChunkName,
+			TArray<uint8>& OutBytecode, FString& OutError, bool bStrip = false);
+
+		// write the .luac of every .lua under SourceDir to the same tree under OutputDir,
+		// the chunk name is the clean file name as the one of TLua::DoFile
+		int32 Cook(const FString& SourceDir, const FString& OutputDir, bool bStrip, FOutputDevice& Ar);
+
+		// compile the files of the startup manifest in parallel, each in a throwaway state,
+		// and record the files loaded until ReleasePrepared
+		void Prepare();
+		// drop the prepared chunks never loaded and save the manifest of the recorded files,
+		// the later loads use the cache files
+		void ReleasePrepared();
+
+		// wait for the cache files in flight
+		void Flush();
+		void Clear();
+
+		inline const BytecodeCacheStats& GetStats() const
+		{
+			return Stats;
+		}
+
+	private:
+		BytecodeCache();
+
+		FString GetCachePath(const FString& FullName) const;
+		FString GetManifestPath() const;
+		bool LoadCooked(lua_State* State, const FString& FileName);
+		void WriteAsync(FString Path, TArray<uint8> Data);
+
+	private:
+		struct PreparedChunk
+		{
+			FString ChunkName;
+			TArray<uint8> Bytecode;
+		};
+
+		FString CacheDir;
+		TMap<FString, PreparedChunk> Prepared;	// by the full path
+		bool bRecording;
+		TArray<FString> StartupFiles;			// "chunk name\tfull path" in the load order
+		TArray<FString> StartupManifest;		// the one of the last startup
+		TArray<UE::Tasks::FTask> Writes;
+		BytecodeCacheStats Stats;
+	};
+
+	// lua bytecode [cook <dir> [strip] | clear | flush]
+	TLua_API void ExecBytecodeCommand(const TCHAR* Cmd, FOutputDevice& Ar);
+}
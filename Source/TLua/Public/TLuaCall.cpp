@@ -1,10 +1,221 @@
-
 #include "TLuaCall.hpp"
 
 #include "CoreMinimal.h"
 
 namespace TLua
 {
+	// bumped when the global functions may be reassigned
+	static int HandleGeneration = 1;
+
+#if !TLUA_NATIVE_TRACE_HANDLER
+	// trace_call is shared by all handles
+	static int TraceRef = LUA_NOREF;
+	static int TraceGeneration = 0;
+#endif
+
+	FunctionHandle::FunctionHandle(const char* InName)
+		: Name(InName), FunctionRef(LUA_NOREF), Generation(0)
+	{
+	}
+
+	FunctionHandle::~FunctionHandle()
+	{
+		Invalidate();
+	}
+
+	void FunctionHandle::Invalidate()
+	{
+		if (FunctionRef != LUA_NOREF && FunctionRef != LUA_REFNIL) {
+			luaL_unref(GetLuaState(), LUA_REGISTRYINDEX, FunctionRef);
+		}
+		FunctionRef = LUA_NOREF;
+		Generation = 0;
+	}
+
+	void FunctionHandle::Resolve(lua_State* State)
+	{
+		Invalidate();
+
+		lua_getglobal(State, Name.c_str());
+		FunctionRef = luaL_ref(State, LUA_REGISTRYINDEX); // nil -> LUA_REFNIL
+		if (FunctionRef != LUA_REFNIL) {
+			// don't cache the missing function, it may be defined later
+			Generation = HandleGeneration;
+		}
+	}
+
+	// stack: ... -> ..., handler, fun
+	int FunctionHandle::Push(lua_State* State)
+	{
+#if TLUA_NATIVE_TRACE_HANDLER
+		int Handler = LuaPushTraceHandler(State);
+#else
+		if (TraceGeneration != HandleGeneration) {
+			if (TraceRef != LUA_NOREF && TraceRef != LUA_REFNIL) {
+				luaL_unref(State, LUA_REGISTRYINDEX, TraceRef);
+			}
+			lua_getglobal(State, TLUA_TRACE_CALL_NAME);
+			TraceRef = luaL_ref(State, LUA_REGISTRYINDEX);
+			TraceGeneration = (TraceRef == LUA_REFNIL) ? 0 : HandleGeneration;
+		}
+
+		lua_rawgeti(State, LUA_REGISTRYINDEX, TraceRef);
+		int Handler = lua_gettop(State);
+#endif
+
+		PushFunction(State);
+		return Handler;
+	}
+
+	void FunctionHandle::PushFunction(lua_State* State)
+	{
+		if (Generation != HandleGeneration) {
+			Resolve(State);
+		}
+
+		lua_rawgeti(State, LUA_REGISTRYINDEX, FunctionRef);
+	}
+
+	void InvalidateFunctionHandles()
+	{
+		++HandleGeneration;
+	}
+
+	// _batch_dispatch(items, fun, size) -> error_number, skipped_number
+	// items: [argument_number, object proxy, method, args...]...
+	// the dispatcher gets the object as the light userdata, as the other calls
+	static int CppBatchDispatch(lua_State* State)
+	{
+		int Size = (int)lua_tointeger(State, 3);
+		int Handler = LuaPushTraceHandler(State);
+		int Errors = 0;
+		int Skipped = 0;
+
+		int Cursor = 1;
+		while (Cursor <= Size) {
+			lua_rawgeti(State, 1, Cursor);
+			int ArgNum = (int)lua_tointeger(State, -1);
+			lua_pop(State, 1);
+
+			lua_rawgeti(State, 1, Cursor + 1);
+			UObject* Object = TypeInfo<UObject*>::FromLua(State, -1);
+			lua_pop(State, 1);
+			if (!Object) {
+				for (int Index = 1; Index <= ArgNum; ++Index) {
+					lua_pushnil(State);
+					lua_rawseti(State, 1, Cursor + Index);
+				}
+				++Skipped;
+				Cursor += ArgNum + 1;
+				continue;
+			}
+
+			LuaCheckStack(State, ArgNum + 2);
+#if TLUA_NATIVE_TRACE_HANDLER
+			lua_pushvalue(State, 2);									// fun
+#else
+			lua_pushvalue(State, Handler);								// trace_call
+			lua_pushvalue(State, 2);									// trace_call, fun
+#endif
+			lua_pushlightuserdata(State, Object);
+			for (int Index = 1; Index <= ArgNum; ++Index) {
+				if (Index > 1) {
+					lua_rawgeti(State, 1, Cursor + Index);
+				}
+				// release the reference for the next batch
+				lua_pushnil(State);
+				lua_rawseti(State, 1, Cursor + Index);
+			}
+
+#if TLUA_NATIVE_TRACE_HANDLER
+			int Result = lua_pcall(State, ArgNum, 0, Handler);
+#else
+			int Result = lua_pcall(State, ArgNum + 1, 0, 0);
+#endif
+			if (Result != LUA_OK) {
+				CheckState(Result, State);
+				lua_pop(State, 1);
+				++Errors;
+			}
+
+			Cursor += ArgNum + 1;
+		}
+
+		lua_pushinteger(State, Errors);
+		lua_pushinteger(State, Skipped);
+		return 2;
+	}
+
+	BatchCall::BatchCall(const char* InDispatcher)
+		: Dispatcher(InDispatcher), ItemsRef(LUA_NOREF), Cursor(0), Count(0), bFlushing(false)
+	{
+	}
+
+	BatchCall::~BatchCall()
+	{
+		if (ItemsRef != LUA_NOREF) {
+			luaL_unref(GetLuaState(), LUA_REGISTRYINDEX, ItemsRef);
+		}
+	}
+
+	// stack: ... -> ..., items
+	int BatchCall::PushItems(lua_State* State)
+	{
+		if (ItemsRef == LUA_NOREF) {
+			lua_createtable(State, 64, 0);
+			ItemsRef = luaL_ref(State, LUA_REGISTRYINDEX);
+		}
+
+		lua_rawgeti(State, LUA_REGISTRYINDEX, ItemsRef);
+		return lua_gettop(State);
+	}
+
+	int BatchCall::Flush()
+	{
+		// the nested flush from a dispatched call, the outer one is still running
+		if (Count == 0 || bFlushing) {
+			return 0;
+		}
+
+		lua_State* State = GetLuaState();
+		bFlushing = true;
+
+		// the items added by the dispatched calls go to a new buffer, flushed next time
+		int BatchRef = ItemsRef;
+		int BatchSize = Cursor;
+		int BatchCount = Count;
+		ItemsRef = LUA_NOREF;
+		Cursor = 0;
+		Count = 0;
+
+		int Handler = LuaPushTraceHandler(State);
+		lua_pushcfunction(State, CppBatchDispatch);
+		lua_rawgeti(State, LUA_REGISTRYINDEX, BatchRef);
+		Dispatcher.PushFunction(State);
+		lua_pushinteger(State, BatchSize);
+		LuaTraceCall(State, Handler, 3, 2);
+
+		int Errors = (int)lua_tointeger(State, -2);
+		int Skipped = (int)lua_tointeger(State, -1);
+		lua_pop(State, 2);
+
+		// the dispatch released the items, reuse the buffer if no new one
+		if (ItemsRef == LUA_NOREF) {
+			ItemsRef = BatchRef;
+		}
+		else {
+			luaL_unref(State, LUA_REGISTRYINDEX, BatchRef);
+		}
+		bFlushing = false;
+
+		Stats.Batches += 1;
+		Stats.Calls += BatchCount;
+		Stats.Errors += Errors;
+		Stats.Skipped += Skipped;
+		Stats.LastBatchSize = BatchCount;
+
+		return Errors;
+	}
 
 	static void RegisterActor()
 	{
@@ -20,4 +231,4 @@ namespace TLua
 		RegisterComponent();
 		RegisterActor();
 	}
-}
\ No newline at end of file
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <string>
+
 #include "Lua/lua.hpp"
 #include "TLuaImp.hpp"
+#include "TLuaTrace.hpp"
 #include "TLuaTypes.hpp"
 
 namespace TLua
@@ -10,9 +13,12 @@ namespace TLua
 	{
 		lua_State* state = GetLuaState();
 
-		LuaGetGlobal(state, TLUA_TRACE_CALL_NAME);
+		int handler = LuaPushTraceHandler(state);
 		LuaGetGlobal(state, name);
-		LuaCall(state, 1);
+		{
+			TLUA_TRACE_SCOPE(name);
+			LuaTraceCall(state, handler, 0);
+		}
 	}
 
 	template <typename ...Types>
@@ -20,10 +26,13 @@ namespace TLua
 	{
 		lua_State* state = GetLuaState();
 
-		LuaGetGlobal(state, TLUA_TRACE_CALL_NAME);
+		int handler = LuaPushTraceHandler(state);
 		LuaGetGlobal(state, name);
 		PushValues(state, args...);
-		LuaCall(state, sizeof...(Types) + 1);
+		{
+			TLUA_TRACE_SCOPE(name);
+			LuaTraceCall(state, handler, sizeof...(Types));
+		}
 	}
 
 	template <typename R, typename ...Types>
@@ -31,18 +40,163 @@ namespace TLua
 	{
 		lua_State* state = GetLuaState();
 
-		LuaGetGlobal(state, TLUA_TRACE_CALL_NAME);
+		int handler = LuaPushTraceHandler(state);
 		LuaGetGlobal(state, name);
 		PushValues(state, args...);
-		LuaCall(state, sizeof...(Types) + 1, 1);
+		{
+			TLUA_TRACE_SCOPE(name);
+			LuaTraceCall(state, handler, sizeof...(Types), 1);
+		}
 
 		return PopValue<R>(state);
 	}
 
+	// keep a global lua function in the registry, so the call path
+	// doesn't need to look up the global table every time.
+	// the handle is resolved lazily and re-resolved after InvalidateFunctionHandles.
+	// DoFile/DoString invalidate the handles, the script reassigning a global function
+	// at runtime calls _cpp_invalidate_function_handles().
+	class TLua_API FunctionHandle
+	{
+	public:
+		explicit FunctionHandle(const char* InName);
+		~FunctionHandle();
+
+		FunctionHandle(const FunctionHandle&) = delete;
+		FunctionHandle& operator=(const FunctionHandle&) = delete;
+
+		template <typename ...Types>
+		inline void Call(const Types&... Args)
+		{
+			lua_State* State = GetLuaState();
+
+			int Handler = Push(State);		// handler, fun
+			PushValues(State, Args...);		// handler, fun, args...
+			{
+				TLUA_TRACE_SCOPE(GetName());
+				LuaTraceCall(State, Handler, sizeof...(Types));
+			}
+		}
+
+		template <typename R, typename ...Types>
+		inline R RCall(const Types&... Args)
+		{
+			lua_State* State = GetLuaState();
+
+			int Handler = Push(State);
+			PushValues(State, Args...);
+			{
+				TLUA_TRACE_SCOPE(GetName());
+				LuaTraceCall(State, Handler, sizeof...(Types), 1);
+			}
+
+			return PopValue<R>(State);
+		}
+
+		inline const char* GetName() const
+		{
+			return Name.c_str();
+		}
+
+		void Invalidate();
+
+		// stack: ... -> ..., fun
+		void PushFunction(lua_State* State);
+
+	private:
+		int Push(lua_State* State);
+		void Resolve(lua_State* State);
+
+	private:
+		std::string Name;
+		int FunctionRef;
+		int Generation;
+	};
+
+	// call this after the global functions are reassigned, (reload the script file)
+	TLua_API void InvalidateFunctionHandles();
+
+	struct BatchCallStats
+	{
+		uint64 Batches = 0;
+		uint64 Calls = 0;
+		uint64 Errors = 0;
+		uint64 Skipped = 0;		// the object died before the flush
+		int32 LastBatchSize = 0;
+
+		inline double GetCallsPerBatch() const
+		{
+			return Batches ? (double)Calls / (double)Batches : 0.0;
+		}
+	};
+
+	// gather the (object, method, args...) calls and dispatch them in one pcall.
+	// every item is called as dispatcher(object, method, args...) in its own
+	// protected call, so an error only breaks the item. the object is kept by the
+	// weak proxy until the flush, the items of the dead objects are skipped.
+	class TLua_API BatchCall
+	{
+	public:
+		explicit BatchCall(const char* InDispatcher = "_lua_call");
+		~BatchCall();
+
+		BatchCall(const BatchCall&) = delete;
+		BatchCall& operator=(const BatchCall&) = delete;
+
+		template <typename ...Types>
+		void Add(UObject* Object, const char* Method, const Types&... Args)
+		{
+			lua_State* State = GetLuaState();
+
+			int Items = PushItems(State);							// items
+			AddValue(State, Items, (int)sizeof...(Types) + 2);		// argument number
+			TypeInfo<UObject*>::ToLua(State, Object);				// items, proxy
+			lua_rawseti(State, Items, ++Cursor);
+			AddValue(State, Items, Method);
+			(AddValue(State, Items, Args), ...);
+			LuaPop(State, 1);
+
+			++Count;
+		}
+
+		// call all the gathered items, return the number of failed items.
+		// the items added during the flush wait for the next one, the nested flush does nothing
+		int Flush();
+
+		inline int Num() const
+		{
+			return Count;
+		}
+
+		inline const BatchCallStats& GetStats() const
+		{
+			return Stats;
+		}
+
+	private:
+		template <typename Type>
+		inline void AddValue(lua_State* State, int Items, const Type& Value)
+		{
+			PushValue(State, Value);
+			lua_rawseti(State, Items, ++Cursor);
+		}
+
+		int PushItems(lua_State* State);
+
+	private:
+		FunctionHandle Dispatcher;
+		int ItemsRef;
+		int Cursor;
+		int Count;
+		bool bFlushing;
+		BatchCallStats Stats;
+	};
+
 	template <typename ...Types>
 	inline void CallMethod(UObject* Object, const char* Name, const Types&... Args)
 	{
-		Call("_lua_call_method", (void*)Object, Name, Args...);
+		static FunctionHandle Handle("_lua_call_method");
+		Handle.Call((void*)Object, Name, Args...);
 	}
 
 	using LuaCFun = int (*)(lua_State* state);
@@ -160,7 +314,7 @@ namespace TLua
 		static int Callback(lua_State* State)
 		{
 			using ContextType = MethodContext<Type, ReturnType, ArgTypes...>;
-			UObject* Object = (UObject*)LuaGetUserData(State, 1);
+			UObject* Object = TypeInfo<UObject*>::FromLua(State, 1);
 			Type* Self = Cast<Type>(Object);
 			if (!Self) {
 				return 0;
@@ -177,7 +331,7 @@ namespace TLua
 		static int CallbackWithReturn(lua_State* State)
 		{
 			using ContextType = MethodContext<Type, ReturnType, ArgTypes...>;
-			UObject* Object = (UObject*)LuaGetUserData(State, 1);
+			UObject* Object = TypeInfo<UObject*>::FromLua(State, 1);
 			Type* Self = Cast<Type>(Object);
 			if (!Self) {
 				return 0;
@@ -0,0 +1,548 @@
+#include "TLuaContainerView.hpp"
+
+#include "TLua.h"
+#include "TLuaObjectProxy.hpp"
+#include "TLuaProperty.hpp"
+#include "TLuaStructProxy.hpp"
+
+namespace TLua
+{
+	// registry[&Key] = metatable of the view
+	static char ArrayViewKey;
+	static char MapViewKey;
+	static char SetViewKey;
+	// metatable[&ContainerViewTag] = true
+	static char ContainerViewTag;
+
+	// the address of the first element, changed when the container reallocates
+	static const void* GetContainerData(const ContainerView* View)
+	{
+		if (FArrayProperty* ArrayProperty = CastField<FArrayProperty>(View->Property)) {
+			return FScriptArrayHelper(ArrayProperty, View->Container).GetRawPtr();
+		}
+		if (FMapProperty* MapProperty = CastField<FMapProperty>(View->Property)) {
+			FScriptMapHelper Map(MapProperty, View->Container);
+			return Map.GetMaxIndex() > 0 ? Map.GetPairPtrWithoutCheck(0) : nullptr;
+		}
+		FScriptSetHelper Set((FSetProperty*)View->Property, View->Container);
+		return Set.GetMaxIndex() > 0 ? Set.GetElementPtrWithoutCheck(0) : nullptr;
+	}
+
+	static bool IsSlotValid(const ContainerView* View, const ElementSlot& Slot)
+	{
+		if (GetContainerData(View) != Slot.Data) {
+			return false;
+		}
+
+		if (FArrayProperty* ArrayProperty = CastField<FArrayProperty>(View->Property)) {
+			return FScriptArrayHelper(ArrayProperty, View->Container).IsValidIndex(Slot.Index);
+		}
+		if (FMapProperty* MapProperty = CastField<FMapProperty>(View->Property)) {
+			return FScriptMapHelper(MapProperty, View->Container).IsValidIndex(Slot.Index);
+		}
+		return FScriptSetHelper((FSetProperty*)View->Property, View->Container).IsValidIndex(Slot.Index);
+	}
+
+	// walk the owners, the reference is invalid if the owner object is dead or
+	// an element on the way left its container
+	bool IsReferenceValid(lua_State* State, int Index)
+	{
+		int Top = lua_gettop(State);
+		bool Valid = true;
+
+		lua_pushvalue(State, Index);								// ref
+		while (true) {
+			// struct proxy or view, both start with the slot
+			const ElementSlot& Slot = *(const ElementSlot*)lua_touserdata(State, -1);
+
+			// the inline struct has no user value
+			if (lua_getiuservalue(State, -1, 1) != LUA_TUSERDATA) {		// ref, owner
+				break;
+			}
+			if (ToObjectProxy(State, -1)) {
+				Valid = GetProxyObject(State, -1) != nullptr;
+				break;
+			}
+			if (Slot.Index != INDEX_NONE && !IsSlotValid((const ContainerView*)lua_touserdata(State, -1), Slot)) {
+				Valid = false;
+				break;
+			}
+			lua_remove(State, -2);									// owner
+		}
+
+		lua_settop(State, Top);
+		return Valid;
+	}
+
+	void CheckReference(lua_State* State, int Index)
+	{
+		if (!IsReferenceValid(State, Index)) {
+			luaL_error(State, "access the memory of an invalid object or a changed container");
+		}
+	}
+
+	// stack: ..., value
+	// bind the element at the index of the view at ViewIndex
+	static void BindElement(lua_State* State, int ViewIndex, const ContainerView* View, int32 Index)
+	{
+		if (BindOwner(State, ViewIndex)) {
+			ElementSlot& Slot = *(ElementSlot*)lua_touserdata(State, -1);
+			Slot.Data = GetContainerData(View);
+			Slot.Index = Index;
+		}
+	}
+
+	// the userdata at the index must have the metatable at registry[Key]
+	static ContainerView* CheckView(lua_State* State, int Index, void* Key)
+	{
+		ContainerView* View = nullptr;
+		if (lua_type(State, Index) == LUA_TUSERDATA && lua_getmetatable(State, Index)) {
+			lua_rawgetp(State, LUA_REGISTRYINDEX, Key);
+			if (lua_rawequal(State, -1, -2)) {
+				View = (ContainerView*)lua_touserdata(State, Index);
+			}
+			lua_pop(State, 2);
+		}
+
+		if (!View) {
+			luaL_typeerror(State, Index, Key == &ArrayViewKey ? "array view" : Key == &MapViewKey ? "map view" : "set view");
+		}
+		CheckReference(State, Index);
+		return View;
+	}
+
+	// stack: ... -> ..., view
+	static ContainerView* NewView(lua_State* State, void* Key, FProperty* Property, void* Container)
+	{
+		ContainerView* View = (ContainerView*)lua_newuserdatauv(State, sizeof(ContainerView), 1);
+		View->Slot = { nullptr, INDEX_NONE };
+		View->Property = Property;
+		View->Element = nullptr;
+		View->Value = nullptr;
+		View->Container = Container;
+
+		lua_rawgetp(State, LUA_REGISTRYINDEX, Key);
+		lua_setmetatable(State, -2);
+
+		return View;
+	}
+
+	void PushArrayView(lua_State* State, FArrayProperty* Property, PropertyProcessor* Inner, void* Container)
+	{
+		ContainerView* View = NewView(State, &ArrayViewKey, Property, Container);
+		View->Element = Inner;
+	}
+
+	void PushMapView(lua_State* State, FMapProperty* Property,
+		PropertyProcessor* Key, PropertyProcessor* Value, void* Container)
+	{
+		ContainerView* View = NewView(State, &MapViewKey, Property, Container);
+		View->Element = Key;
+		View->Value = Value;
+	}
+
+	void PushSetView(lua_State* State, FSetProperty* Property, PropertyProcessor* Element, void* Container)
+	{
+		ContainerView* View = NewView(State, &SetViewKey, Property, Container);
+		View->Element = Element;
+	}
+
+	ContainerView* ToContainerView(lua_State* State, int Index, const FProperty* Property)
+	{
+		if (lua_type(State, Index) != LUA_TUSERDATA || !lua_getmetatable(State, Index)) {
+			return nullptr;
+		}
+
+		lua_rawgetp(State, -1, &ContainerViewTag);
+		bool IsView = lua_toboolean(State, -1);
+		lua_pop(State, 2);
+		if (!IsView) {
+			return nullptr;
+		}
+
+		ContainerView* View = (ContainerView*)lua_touserdata(State, Index);
+		if (Property && !View->Property->SameType(Property)) {
+			return nullptr;
+		}
+		return View;
+	}
+
+	bool BindOwner(lua_State* State, int OwnerIndex)
+	{
+		OwnerIndex = lua_absindex(State, OwnerIndex);
+		if (!ToStructProxy(State, -1) && !ToContainerView(State, -1, nullptr)) {
+			return false;
+		}
+
+		// the inline value has no user value, nothing is set
+		lua_pushvalue(State, OwnerIndex);
+		return lua_setiuservalue(State, -2, 1) != 0;
+	}
+
+	// array view
+
+	// __index(view, index)
+	static int CppArrayIndex(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &ArrayViewKey);
+		FScriptArrayHelper Array((FArrayProperty*)View->Property, View->Container);
+
+		lua_Integer Index = lua_tointeger(State, 2);
+		if (Index < 1 || Index > Array.Num()) {
+			lua_pushnil(State);
+			return 1;
+		}
+
+		View->Element->ToLua(State, Array.GetRawPtr((int32)Index - 1));
+		BindElement(State, 1, View, (int32)Index - 1);
+		return 1;
+	}
+
+	// __newindex(view, index, value), index #view + 1 append the value
+	static int CppArrayNewIndex(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &ArrayViewKey);
+		FScriptArrayHelper Array((FArrayProperty*)View->Property, View->Container);
+
+		lua_Integer Index = luaL_checkinteger(State, 2);
+		if (Index == Array.Num() + 1) {
+			Array.AddValue();
+		}
+		else if (Index < 1 || Index > Array.Num()) {
+			return luaL_error(State, "array index %d out of range [1, %d]", (int)Index, Array.Num() + 1);
+		}
+
+		View->Element->FromLua(State, 3, Array.GetRawPtr((int32)Index - 1));
+		return 0;
+	}
+
+	static int CppArrayLen(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &ArrayViewKey);
+		FScriptArrayHelper Array((FArrayProperty*)View->Property, View->Container);
+
+		lua_pushinteger(State, Array.Num());
+		return 1;
+	}
+
+	// _array_next(view, index) -> index + 1, value
+	static int CppArrayNext(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &ArrayViewKey);
+		FScriptArrayHelper Array((FArrayProperty*)View->Property, View->Container);
+
+		lua_Integer Index = luaL_optinteger(State, 2, 0) + 1;
+		if (Index > Array.Num()) {
+			return 0;
+		}
+
+		lua_pushinteger(State, Index);
+		View->Element->ToLua(State, Array.GetRawPtr((int32)Index - 1));
+		BindElement(State, 1, View, (int32)Index - 1);
+		return 2;
+	}
+
+	// __pairs(view) -> next, view, 0
+	static int CppArrayPairs(lua_State* State)
+	{
+		CheckView(State, 1, &ArrayViewKey);
+		lua_pushcfunction(State, CppArrayNext);
+		lua_pushvalue(State, 1);
+		lua_pushinteger(State, 0);
+		return 3;
+	}
+
+	// map view
+
+	// stack: view, key, ..., the key is converted to the temporary memory
+	// return the index of the pair, INDEX_NONE if not found
+	static int32 FindMapIndex(lua_State* State, ContainerView* View)
+	{
+		FMapProperty* Property = (FMapProperty*)View->Property;
+		FScriptMapHelper Map(Property, View->Container);
+
+		FProperty* KeyProp = Property->KeyProp;
+		uint8* Key = (uint8*)FMemory_Alloca_Aligned(KeyProp->GetSize(), KeyProp->GetMinAlignment());
+		KeyProp->InitializeValue(Key);
+		View->Element->FromLua(State, 2, Key);
+
+		int32 Index = Map.FindMapIndexWithKey(Key);
+		KeyProp->DestroyValue(Key);
+
+		return Index;
+	}
+
+	// __index(view, key)
+	static int CppMapIndex(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &MapViewKey);
+		FScriptMapHelper Map((FMapProperty*)View->Property, View->Container);
+
+		int32 Index = FindMapIndex(State, View);
+		if (Index == INDEX_NONE) {
+			lua_pushnil(State);
+			return 1;
+		}
+
+		View->Value->ToLua(State, Map.GetPairPtr(Index));
+		BindElement(State, 1, View, Index);
+		return 1;
+	}
+
+	// __newindex(view, key, value), nil value remove the key
+	static int CppMapNewIndex(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &MapViewKey);
+		FMapProperty* Property = (FMapProperty*)View->Property;
+		FScriptMapHelper Map(Property, View->Container);
+
+		if (lua_isnil(State, 3)) {
+			int32 Index = FindMapIndex(State, View);
+			if (Index != INDEX_NONE) {
+				Map.RemoveAt(Index);
+			}
+			return 0;
+		}
+
+		// the temporary pair, the key at 0 and the value at the offset of the layout
+		FProperty* KeyProp = Property->KeyProp;
+		FProperty* ValueProp = Property->ValueProp;
+		int32 ValueOffset = ValueProp->GetOffset_ForInternal();
+		uint8* Pair = (uint8*)FMemory_Alloca_Aligned(ValueOffset + ValueProp->GetSize(),
+			FMath::Max(KeyProp->GetMinAlignment(), ValueProp->GetMinAlignment()));
+
+		KeyProp->InitializeValue(Pair);
+		ValueProp->InitializeValue(Pair + ValueOffset);
+		View->Element->FromLua(State, 2, Pair);
+		View->Value->FromLua(State, 3, Pair);
+
+		Map.AddPair(Pair, Pair + ValueOffset);
+
+		KeyProp->DestroyValue(Pair);
+		ValueProp->DestroyValue(Pair + ValueOffset);
+		return 0;
+	}
+
+	static int CppMapLen(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &MapViewKey);
+		FScriptMapHelper Map((FMapProperty*)View->Property, View->Container);
+
+		lua_pushinteger(State, Map.Num());
+		return 1;
+	}
+
+	// _map_next(view) -> key, value, upvalue: sparse index
+	static int CppMapNext(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &MapViewKey);
+		FScriptMapHelper Map((FMapProperty*)View->Property, View->Container);
+
+		int32 Index = (int32)lua_tointeger(State, lua_upvalueindex(1));
+		int32 MaxIndex = Map.GetMaxIndex();
+		while (Index < MaxIndex && !Map.IsValidIndex(Index)) {
+			++Index;
+		}
+		if (Index >= MaxIndex) {
+			return 0;
+		}
+
+		lua_pushinteger(State, Index + 1);
+		lua_replace(State, lua_upvalueindex(1));
+
+		uint8* Pair = Map.GetPairPtr(Index);
+		View->Element->ToLua(State, Pair);
+		BindElement(State, 1, View, Index);
+		View->Value->ToLua(State, Pair);
+		BindElement(State, 1, View, Index);
+		return 2;
+	}
+
+	// __pairs(view) -> next, view, nil
+	static int CppMapPairs(lua_State* State)
+	{
+		CheckView(State, 1, &MapViewKey);
+		lua_pushinteger(State, 0);
+		lua_pushcclosure(State, CppMapNext, 1);
+		lua_pushvalue(State, 1);
+		lua_pushnil(State);
+		return 3;
+	}
+
+	// set view
+
+	// stack: view, element, ..., return the index of the element, INDEX_NONE if not found
+	// Add: add the element if not found
+	static int32 FindSetIndex(lua_State* State, ContainerView* View, bool Add)
+	{
+		FSetProperty* Property = (FSetProperty*)View->Property;
+		FScriptSetHelper Set(Property, View->Container);
+
+		FProperty* ElementProp = Property->ElementProp;
+		uint8* Element = (uint8*)FMemory_Alloca_Aligned(ElementProp->GetSize(), ElementProp->GetMinAlignment());
+		ElementProp->InitializeValue(Element);
+		View->Element->FromLua(State, 2, Element);
+
+		int32 Index = Set.FindElementIndex(Element);
+		if (Index == INDEX_NONE && Add) {
+			Set.AddElement(Element);
+		}
+		ElementProp->DestroyValue(Element);
+
+		return Index;
+	}
+
+	// __index(view, element) -> true | nil
+	static int CppSetIndex(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &SetViewKey);
+		if (FindSetIndex(State, View, false) == INDEX_NONE) {
+			lua_pushnil(State);
+		}
+		else {
+			lua_pushboolean(State, 1);
+		}
+		return 1;
+	}
+
+	// __newindex(view, element, bool), add the element for true, remove for false
+	static int CppSetNewIndex(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &SetViewKey);
+
+		if (lua_toboolean(State, 3)) {
+			FindSetIndex(State, View, true);
+			return 0;
+		}
+
+		int32 Index = FindSetIndex(State, View, false);
+		if (Index != INDEX_NONE) {
+			FScriptSetHelper Set((FSetProperty*)View->Property, View->Container);
+			Set.RemoveAt(Index);
+		}
+		return 0;
+	}
+
+	static int CppSetLen(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &SetViewKey);
+		FScriptSetHelper Set((FSetProperty*)View->Property, View->Container);
+
+		lua_pushinteger(State, Set.Num());
+		return 1;
+	}
+
+	// _set_next(view) -> element, true, upvalue: sparse index
+	static int CppSetNext(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &SetViewKey);
+		FScriptSetHelper Set((FSetProperty*)View->Property, View->Container);
+
+		int32 Index = (int32)lua_tointeger(State, lua_upvalueindex(1));
+		int32 MaxIndex = Set.GetMaxIndex();
+		while (Index < MaxIndex && !Set.IsValidIndex(Index)) {
+			++Index;
+		}
+		if (Index >= MaxIndex) {
+			return 0;
+		}
+
+		lua_pushinteger(State, Index + 1);
+		lua_replace(State, lua_upvalueindex(1));
+
+		View->Element->ToLua(State, Set.GetElementPtr(Index));
+		BindElement(State, 1, View, Index);
+		lua_pushboolean(State, 1);
+		return 2;
+	}
+
+	// __pairs(view) -> next, view, nil
+	static int CppSetPairs(lua_State* State)
+	{
+		CheckView(State, 1, &SetViewKey);
+		lua_pushinteger(State, 0);
+		lua_pushcclosure(State, CppSetNext, 1);
+		lua_pushvalue(State, 1);
+		lua_pushnil(State);
+		return 3;
+	}
+
+	// _cpp_array_remove(view, index)
+	static int CppArrayRemove(lua_State* State)
+	{
+		ContainerView* View = CheckView(State, 1, &ArrayViewKey);
+		FScriptArrayHelper Array((FArrayProperty*)View->Property, View->Container);
+
+		lua_Integer Index = luaL_checkinteger(State, 2);
+		if (Index >= 1 && Index <= Array.Num()) {
+			Array.RemoveValues((int32)Index - 1, 1);
+		}
+		return 0;
+	}
+
+	// _cpp_container_clear(view)
+	static int CppContainerClear(lua_State* State)
+	{
+		ContainerView* View = ToContainerView(State, 1, nullptr);
+		if (!View) {
+			return luaL_typeerror(State, 1, "container view");
+		}
+		CheckReference(State, 1);
+
+		if (FArrayProperty* ArrayProperty = CastField<FArrayProperty>(View->Property)) {
+			FScriptArrayHelper(ArrayProperty, View->Container).EmptyValues();
+		}
+		else if (FMapProperty* MapProperty = CastField<FMapProperty>(View->Property)) {
+			FScriptMapHelper(MapProperty, View->Container).EmptyValues();
+		}
+		else if (FSetProperty* SetProperty = CastField<FSetProperty>(View->Property)) {
+			FScriptSetHelper(SetProperty, View->Container).EmptyElements();
+		}
+		return 0;
+	}
+
+	static void NewViewMetatable(lua_State* State, void* Key, const char* Name, const luaL_Reg* Methods)
+	{
+		lua_newtable(State);
+		luaL_setfuncs(State, Methods, 0);
+
+		lua_pushboolean(State, 1);
+		lua_rawsetp(State, -2, &ContainerViewTag);
+		lua_pushstring(State, Name);
+		lua_setfield(State, -2, "__name");
+
+		lua_rawsetp(State, LUA_REGISTRYINDEX, Key);
+	}
+
+	void RegisterContainerView(lua_State* State)
+	{
+		static const luaL_Reg ArrayMethods[] = {
+			{ "__index", CppArrayIndex },
+			{ "__newindex", CppArrayNewIndex },
+			{ "__len", CppArrayLen },
+			{ "__pairs", CppArrayPairs },
+			{ nullptr, nullptr }
+		};
+		static const luaL_Reg MapMethods[] = {
+			{ "__index", CppMapIndex },
+			{ "__newindex", CppMapNewIndex },
+			{ "__len", CppMapLen },
+			{ "__pairs", CppMapPairs },
+			{ nullptr, nullptr }
+		};
+		static const luaL_Reg SetMethods[] = {
+			{ "__index", CppSetIndex },
+			{ "__newindex", CppSetNewIndex },
+			{ "__len", CppSetLen },
+			{ "__pairs", CppSetPairs },
+			{ nullptr, nullptr }
+		};
+
+		NewViewMetatable(State, &ArrayViewKey, "TArray", ArrayMethods);
+		NewViewMetatable(State, &MapViewKey, "TMap", MapMethods);
+		NewViewMetatable(State, &SetViewKey, "TSet", SetMethods);
+
+		lua_register(State, "_cpp_array_remove", CppArrayRemove);
+		lua_register(State, "_cpp_container_clear", CppContainerClear);
+	}
+}
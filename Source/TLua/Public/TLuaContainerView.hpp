@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "UObject/UnrealType.h"
+
+namespace TLua
+{
+	class PropertyProcessor;
+
+	// the reference into the element of a view (struct reference, nested view) records the
+	// data of the parent container and the element index. the add, remove, clear or rehash
+	// of the parent moves the data or drops the index, the reference is invalid then
+	struct ElementSlot
+	{
+		const void* Data;
+		int32 Index;					// INDEX_NONE: not an element of a view
+	};
+
+	// full userdata over the TArray/TMap/TSet of the owner, the elements are read on access.
+	// user value 1: the owner (object proxy, struct proxy or view), checked before every access.
+	struct ContainerView
+	{
+		ElementSlot Slot;				// the first member, shared with StructProxy
+		FProperty* Property;			// FArrayProperty | FMapProperty | FSetProperty
+		PropertyProcessor* Element;		// array inner | map key | set element
+		PropertyProcessor* Value;		// map value
+		void* Container;				// FScriptArray | FScriptMap | FScriptSet
+	};
+
+	TLua_API void PushArrayView(lua_State* State, FArrayProperty* Property, PropertyProcessor* Inner, void* Container);
+	TLua_API void PushMapView(lua_State* State, FMapProperty* Property,
+		PropertyProcessor* Key, PropertyProcessor* Value, void* Container);
+	TLua_API void PushSetView(lua_State* State, FSetProperty* Property, PropertyProcessor* Element, void* Container);
+
+	// return the view at the index, nullptr if it's not a view of the same container type
+	TLua_API ContainerView* ToContainerView(lua_State* State, int Index, const FProperty* Property);
+
+	// stack: ..., value
+	// the reference value (struct reference, container view) keeps the owner at the index,
+	// return false for the other values
+	TLua_API bool BindOwner(lua_State* State, int OwnerIndex);
+
+	// the reference (struct proxy or view) at the index is valid if the owner object is
+	// alive and every element slot on the owner chain is still in its container
+	TLua_API bool IsReferenceValid(lua_State* State, int Index);
+	// raise the error for the invalid reference
+	TLua_API void CheckReference(lua_State* State, int Index);
+
+	void RegisterContainerView(lua_State* State);
+}
@@ -3,7 +3,16 @@
 
 #include "TLua.h"
 #include "TLua.hpp"
+#include "TLuaAllocator.hpp"
+#include "TLuaContainerView.hpp"
 #include "TLuaCppLua.hpp"
+#include "TLuaMemberCache.hpp"
+#include "TLuaNameCache.hpp"
+#include "TLuaProfiler.hpp"
+#include "TLuaTrace.hpp"
+#include "TLuaObjectProxy.hpp"
+#include "TLuaStructProxy.hpp"
+#include "TLuaValueTypes.hpp"
 #include "TLuaTypes.hpp"
 #include "TLuaProperty.hpp"
 
@@ -11,78 +20,198 @@
 
 #include "CoreMinimal.h"
 #include "Blueprint/UserWidget.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
 #include "UObject/UObjectGlobals.h"
 
 namespace TLua
 {
+	// the native classes with their own ProcessEvent, besides UTLuaCallback
+	static TArray<const UClass*> ProcessEventClasses;
+
+	enum class EProcessEvent : uint8
+	{
+		Native,		// UObject::ProcessEvent, the thunk is called directly
+		Actor,		// AActor::ProcessEvent, the gate is checked inline
+		Override,	// always through ProcessEvent
+	};
+
+	// by the class of the object, the weak key never matches a new class at the same address
+	static TMap<TWeakObjectPtr<const UClass>, EProcessEvent> ProcessEventKinds;
+
+	void AddProcessEventClass(const UClass* Class)
+	{
+		ProcessEventClasses.AddUnique(Class);
+		ProcessEventKinds.Reset();
+	}
+
+	static EProcessEvent GetProcessEventKind(const UClass* Class)
+	{
+		TWeakObjectPtr<const UClass> Key(Class);
+		if (const EProcessEvent* Kind = ProcessEventKinds.Find(Key)) {
+			return *Kind;
+		}
+
+		EProcessEvent Kind = EProcessEvent::Native;
+		if (Class->IsChildOf<UTLuaCallback>()) {
+			Kind = EProcessEvent::Override;
+		}
+		else {
+			for (const UClass* Each : ProcessEventClasses) {
+				if (Class->IsChildOf(Each)) {
+					Kind = EProcessEvent::Override;
+					break;
+				}
+			}
+		}
+		if (Kind == EProcessEvent::Native && Class->IsChildOf<AActor>()) {
+			Kind = EProcessEvent::Actor;
+		}
+
+		ProcessEventKinds.Add(Key, Kind);
+		return Kind;
+	}
+
+	// the direct thunk call must not skip what the override does. AActor drops the
+	// calls before the actors of the world are initialized and during the gc, the
+	// same gate is checked here, the calls it would drop (or allow in the editor)
+	// go through ProcessEvent. UTLuaCallback forwards the calls to lua
+	static bool OverrideProcessEvent(const UObject* Object)
+	{
+		switch (GetProcessEventKind(Object->GetClass())) {
+		case EProcessEvent::Native:
+			return false;
+		case EProcessEvent::Actor:
+		{
+			if (IsGarbageCollecting()) {
+				return true;
+			}
+			if (Object->HasAnyFlags(RF_ClassDefaultObject)) {
+				return false;
+			}
+			UWorld* World = Object->GetWorld();
+			return !World || !World->AreActorsInitialized();
+		}
+		default:
+			return true;
+		}
+	}
+
 	FunctionContext::FunctionContext(UFunction* InFunction)
-		: Function(InFunction), Return(nullptr)
+		: Function(InFunction), Return(nullptr), bConstructReturn(false), bDestroyReturn(false), bNativeCall(false)
 	{
 		ProcessParameterProperty();
 		ProcessReturnProperty();
+		ProcessLayout();
+	}
+
+	FunctionContext::~FunctionContext()
+	{
+		for (PropertyProcessor* Processor : ParameterProcessors) {
+			delete Processor;
+		}
+		delete Return;
 	}
 
 	// _cpp_object_call(Object, Context, args...)
-	int FunctionContext::Call(lua_State* State, UObject* Object)
+	int FunctionContext::Call(lua_State* State, UObject* Object, int ArgStartIndex)
 	{
-		int ArgStartIndex = 3;
 		void* Parameters = (void*)FMemory_Alloca(Function->ParmsSize);
 		FillParameters(Parameters, State, ArgStartIndex);
 
-		Object->ProcessEvent(Function, Parameters);
+		// the arguments are converted, nothing raises in the scopes
+		{
+			TLUA_TRACE_SCOPE(Function);
+			ProfilerScope Scope(State, EProfilerBoundary::Function, Function);
+
+			if (bNativeCall && !OverrideProcessEvent(Object)) {
+				CallNative(Object, Parameters);
+			}
+			else {
+				Object->ProcessEvent(Function, Parameters);
+			}
+		}
 
 		return FreeParameter(Parameters, State, ArgStartIndex);
 	}
 
-	void FunctionContext::CallLua(int ExtraParameter, void* Parameters)
+	// what ProcessEvent does for the native function, without the callspace and script checks
+	void FunctionContext::CallNative(UObject* Object, void* Parameters)
+	{
+		FFrame Stack(Object, Function, Parameters, nullptr, Function->ChildProperties);
+
+		int OutNum = OutProperties.Num();
+		if (OutNum > 0) {
+			FOutParmRec* OutParms = (FOutParmRec*)FMemory_Alloca(sizeof(FOutParmRec) * OutNum);
+			for (int Index = 0; Index < OutNum; ++Index) {
+				FOutParmRec& Out = OutParms[Index];
+				Out.Property = OutProperties[Index];
+				Out.PropAddr = Out.Property->ContainerPtrToValuePtr<uint8>(Parameters);
+				Out.NextOutParm = Index + 1 < OutNum ? &OutParms[Index + 1] : nullptr;
+			}
+			Stack.OutParms = OutParms;
+		}
+
+		uint8* ReturnValue = nullptr;
+		if (Function->ReturnValueOffset != MAX_uint16) {
+			ReturnValue = (uint8*)Parameters + Function->ReturnValueOffset;
+		}
+
+		Function->Invoke(Object, Stack, ReturnValue);
+	}
+
+	void FunctionContext::CallLua(int Handler, void* Parameters)
 	{
 		lua_State* State = GetLuaState();
 
 		// push parameter to lua
+		// the parameters die after the call, the references must be copied
 		for (auto Processor : ParameterProcessors) {
-			Processor->ToLua(State, Parameters);
+			Processor->ReturnToLua(State, Parameters);
 		}
 
-		int ParameterNumber = ParameterProcessors.Num() + ExtraParameter;
+		int ParameterNumber = ParameterProcessors.Num();
 		int ReturnNumber = 0;
 		if (Return) {
 			ReturnNumber = 1;
 		}
 
 		// call the lua method
-		lua_call(State, ParameterNumber, ReturnNumber);
+		{
+			TLUA_TRACE_SCOPE(Function);
+			LuaTraceCall(State, Handler, ParameterNumber, ReturnNumber);
+		}
 
 		// set the return
 		if (Return) {
 			Return->FromLua(State, -1, Parameters);
+			lua_pop(State, 1);
 		}
-
 	}
 
 	void FunctionContext::FillParameters(void* Parameters, lua_State* State, int ArgStartIndex)
 	{
-		FMemory::Memzero(Parameters, Function->ParmsSize);
-
-		int LuaTop = LuaGetTop(State);
-		for (int Index = 0; Index < ParameterProcessors.Num(); ++Index) {
-			// _cpp_object_call_fun(self, fun_context, args...)
-			PropertyProcessor* Processor = ParameterProcessors[Index];
+		// the missing arguments keep the value of the template
+		FMemory::Memcpy(Parameters, Template.GetData(), Template.Num());
+		for (int32 Index : ConstructIndices) {
+			ParameterProcessors[Index]->Property->InitializeValue_InContainer(Parameters);
+		}
+		if (bConstructReturn) {
+			Return->Property->InitializeValue_InContainer(Parameters);
+		}
 
-			int LuaIndex = Index + ArgStartIndex;
-			if (LuaIndex <= LuaTop) {
-				Processor->FromLua(State, LuaIndex, Parameters);
-			}
-			else {
-				Processor->Property->InitializeValue_InContainer(Parameters);
-			}
+		// _cpp_object_call_fun(self, fun_context, args...)
+		int ArgNum = FMath::Min(LuaGetTop(State) - ArgStartIndex + 1, ParameterProcessors.Num());
+		for (int Index = 0; Index < ArgNum; ++Index) {
+			ParameterProcessors[Index]->FromLua(State, Index + ArgStartIndex, Parameters);
 		}
 	}
 
 	int FunctionContext::FreeParameter(void* Parameters, lua_State* State, int ArgStartIndex)
 	{
-		// free parameter
+		// free parameter, the trivial ones are skipped
 		int LuaTop = LuaGetTop(State);
-		for (int Index = 0; Index < ParameterProcessors.Num(); ++Index) {
+		for (int32 Index : FreeIndices) {
 			PropertyProcessor* Processor = ParameterProcessors[Index];
 
 			int LuaIndex = Index + ArgStartIndex;
@@ -97,13 +226,29 @@ namespace TLua
 		// process return
 		if (Return) {
 			Return->ReturnToLua(State, Parameters);
-			Return->DestroyValue_InContainer(Parameters);
+			if (bDestroyReturn) {
+				Return->DestroyValue_InContainer(Parameters);
+			}
 			return 1;
 		}
 
 		return 0;
 	}
 
+	SIZE_T FunctionContext::GetAllocatedSize() const
+	{
+		SIZE_T Size = sizeof(FunctionContext) + ParameterProcessors.GetAllocatedSize()
+			+ Template.GetAllocatedSize() + ConstructIndices.GetAllocatedSize() + FreeIndices.GetAllocatedSize()
+			+ OutProperties.GetAllocatedSize();
+		for (PropertyProcessor* Processor : ParameterProcessors) {
+			Size += Processor ? Processor->GetAllocatedSize() : 0;
+		}
+		if (Return) {
+			Size += Return->GetAllocatedSize();
+		}
+		return Size;
+	}
+
 	//	private:
 	void FunctionContext::ProcessParameterProperty()
 	{
@@ -128,6 +273,68 @@ namespace TLua
 		Return = CreatePropertyProcessor(Property);
 	}
 
+	// the zeroed memory is a valid value of the property
+	static bool IsZeroConstructible(FProperty* Property)
+	{
+		return Property->HasAnyPropertyFlags(CPF_ZeroConstructor);
+	}
+
+	static bool NeedDestroy(FProperty* Property)
+	{
+		return !Property->HasAnyPropertyFlags(CPF_NoDestructor | CPF_IsPlainOldData);
+	}
+
+	void FunctionContext::ProcessLayout()
+	{
+		Template.SetNumZeroed(Function->ParmsSize);
+
+		for (int Index = 0; Index < ParameterProcessors.Num(); ++Index) {
+			FProperty* Property = ParameterProcessors[Index]->Property;
+
+			if (!IsZeroConstructible(Property)) {
+				// the plain old data can be copied with the template
+				if (Property->HasAnyPropertyFlags(CPF_IsPlainOldData)) {
+					Property->InitializeValue_InContainer(Template.GetData());
+				}
+				else {
+					ConstructIndices.Add(Index);
+				}
+			}
+
+			// the reference struct is copied back to lua in DestroyValue
+			if (NeedDestroy(Property) || Property->HasAnyPropertyFlags(CPF_ReferenceParm)) {
+				FreeIndices.Add(Index);
+			}
+		}
+
+		if (Return) {
+			FProperty* Property = Return->Property;
+			if (!IsZeroConstructible(Property)) {
+				if (Property->HasAnyPropertyFlags(CPF_IsPlainOldData)) {
+					Property->InitializeValue_InContainer(Template.GetData());
+				}
+				else {
+					bConstructReturn = true;
+				}
+			}
+			bDestroyReturn = NeedDestroy(Property);
+		}
+
+#if TLUA_NATIVE_THUNK_CALL
+		// the rpc and the overridable event must be dispatched by ProcessEvent,
+		// the object is checked on every call
+		bNativeCall = Function->HasAnyFunctionFlags(FUNC_Native)
+			&& !Function->HasAnyFunctionFlags(FUNC_Net | FUNC_BlueprintEvent)
+			&& Function->GetNativeFunc() != nullptr;
+#endif
+
+		for (TFieldIterator<FProperty> It(Function); It && It->HasAnyPropertyFlags(CPF_Parm); ++It) {
+			if (It->HasAnyPropertyFlags(CPF_OutParm)) {
+				OutProperties.Add(*It);
+			}
+		}
+	}
+
 	int CppObjectGetName(lua_State* State)
 	{
 		UClass* Object = (UClass*)lua_touserdata(State, 1);
@@ -157,7 +364,7 @@ namespace TLua
 
 	int CppObjectGetType(lua_State* State)
 	{
-		UObject* Object = (UObject*)lua_touserdata(State, 1);
+		UObject* Object = GetValue<UObject*>(State, 1);
 
 		lua_pushlightuserdata(State, Object->GetClass());
 		return 1;
@@ -166,10 +373,13 @@ namespace TLua
 	// _cpp_object_get_attr(self, property)
 	int CppObjectGetAttr(lua_State* State)
 	{
-		UObject* Object = (UObject*)lua_touserdata(State, 1);
+		UObject* Object = GetValue<UObject*>(State, 1);
 		PropertyProcessor* Processor = (PropertyProcessor*)lua_touserdata(State, 2);
 
+		TLUA_TRACE_SCOPE(Processor->Property, false);
+		ProfilerScope Scope(State, EProfilerBoundary::GetProperty, Processor);
 		Processor->ToLua(State, Object);
+		BindOwner(State, 1);
 
 		return 1;
 	}
@@ -177,52 +387,47 @@ namespace TLua
 	// _cpp_object_set_attr(self, property, value)
 	int CppObjectSetAttr(lua_State* State)
 	{
-		UObject* Object = (UObject*)lua_touserdata(State, 1);
+		UObject* Object = GetValue<UObject*>(State, 1);
 		PropertyProcessor* Processor = (PropertyProcessor*)lua_touserdata(State, 2);
-		Processor->FromLua(State, 3, Object);
+		Processor->FromLuaTraced(State, 3, Object);
 
 		return 0;
 	}
 
 	int CppObjectCallFun(lua_State* State)
 	{
-		UClass* Object = (UClass*)lua_touserdata(State, 1);
+		UObject* Object = GetValue<UObject*>(State, 1);
 		FunctionContext* Function = (FunctionContext*)lua_touserdata(State, 2);
 
 		return Function->Call(State, Object);
 	}
 
-	static void SetupPropertyInfo(lua_State* State, FProperty* Property)
+	static int PushMemberInfo(lua_State* State, const MemberInfo& Info)
 	{
-		PropertyProcessor* Processor = CreatePropertyProcessor(Property);
-		lua_pushlightuserdata(State, Processor);
-		lua_pushcfunction(State, CppObjectGetAttr);
-		lua_pushcfunction(State, CppObjectSetAttr);
-	}
-
-	int CppObjectGetInfo(lua_State* State)
-	{
-		UClass* Class = (UClass*)lua_touserdata(State, 1);
-		FName Name(lua_tostring(State, 2));
-
-		FProperty* Property = Class->FindPropertyByName(Name);
-		if (Property) {
-			SetupPropertyInfo(State, Property);
+		if (Info.Processor) {
+			lua_pushlightuserdata(State, Info.Processor);
+			lua_pushcfunction(State, CppObjectGetAttr);
+			lua_pushcfunction(State, CppObjectSetAttr);
 			return 3; // property, getter, setter
 		}
 
-		UFunction* Function = Class->FindFunctionByName(Name);
-		if (Function) {
+		if (Info.Function) {
 			lua_pushnil(State);
-			// every UFunction have only one context at most
-			// so let the memory free.
-			FunctionContext* Context = new FunctionContext(Function);
-			lua_pushlightuserdata(State, Context);
+			lua_pushlightuserdata(State, Info.Function);
 			return 2; // is_property, FunctionContext
 		}
 		return 0; // nil, nil, nil
 	}
 
+	// _cpp_object_get_info(ctype, name) -> is_property, getter, setter
+	int CppObjectGetInfo(lua_State* State)
+	{
+		UClass* Class = (UClass*)lua_touserdata(State, 1);
+		FName Name = NameCache::Get().ToName(State, 2, ENameEncoding::Ansi);
+
+		return PushMemberInfo(State, MemberCache::Get().Find(Class, Name));
+	}
+
 	// _cpp_object_create(parent, name, type)
 	int CppObjectCreate(lua_State* State)
 	{
@@ -253,7 +458,7 @@ namespace TLua
 	// _cpp_object_remove_from_parent()
 	int CppObjectRemoveFromParent(lua_State* State)
 	{
-		UObject* Object = (UObject*)lua_touserdata(State, 1);
+		UObject* Object = GetValue<UObject*>(State, 1);
 		Object->Rename(nullptr, nullptr, REN_DontCreateRedirectors);
 		return 0;
 	}
@@ -271,28 +476,81 @@ namespace TLua
 		return 1;
 	}
 
-	// _cpp_struct_get_info(ctype) -> is_property, getter, setter
+	// _cpp_struct_get_info(ctype, name) -> is_property, getter, setter
 	int CppStructGetInfo(lua_State* State)
 	{
 		UScriptStruct* Struct = (UScriptStruct*)lua_touserdata(State, 1);
-		FName Name(lua_tostring(State, 2));
+		FName Name = NameCache::Get().ToName(State, 2, ENameEncoding::Ansi);
 
-		FProperty* Property = Struct->FindPropertyByName(Name);
-		if (Property) {
-			SetupPropertyInfo(State, Property);
-			return 3; // property, getter, setter
-		}
+		return PushMemberInfo(State, MemberCache::Get().Find(Struct, Name));
+	}
 
-		UFunction* Function = Struct->FindFunction(Name);
-		if (Function) {
-			lua_pushnil(State);
-			// every UFunction have only one context at most
-			// so let the memory free.
-			FunctionContext* Context = new FunctionContext(Function);
-			lua_pushlightuserdata(State, Context);
-			return 2; // is_property, FunctionContext
+	// _cpp_member_cache_stats() -> {hits, misses, members, memory}
+	static int CppMemberCacheStats(lua_State* State)
+	{
+		MemberCacheStats Stats = MemberCache::Get().GetStats();
+
+		lua_createtable(State, 0, 4);
+		lua_pushinteger(State, (lua_Integer)Stats.Hits);
+		lua_setfield(State, -2, "hits");
+		lua_pushinteger(State, (lua_Integer)Stats.Misses);
+		lua_setfield(State, -2, "misses");
+		lua_pushinteger(State, Stats.Members);
+		lua_setfield(State, -2, "members");
+		lua_pushinteger(State, (lua_Integer)Stats.Memory);
+		lua_setfield(State, -2, "memory");
+
+		return 1;
+	}
+
+	// _cpp_name_cache_stats() -> {hits, misses, names}
+	static int CppNameCacheStats(lua_State* State)
+	{
+		NameCacheStats Stats = NameCache::Get().GetStats();
+
+		lua_createtable(State, 0, 3);
+		lua_pushinteger(State, (lua_Integer)Stats.Hits);
+		lua_setfield(State, -2, "hits");
+		lua_pushinteger(State, (lua_Integer)Stats.Misses);
+		lua_setfield(State, -2, "misses");
+		lua_pushinteger(State, Stats.Names);
+		lua_setfield(State, -2, "names");
+
+		return 1;
+	}
+
+	// _cpp_allocator_stats() -> {total, peak, large, reserved, classes = {{size, blocks, allocs, pages}, ...}}
+	static int CppAllocatorStats(lua_State* State)
+	{
+		LuaAllocatorStats Stats = LuaAllocator::Get().GetStats();
+
+		lua_createtable(State, 0, 5);
+		lua_pushinteger(State, (lua_Integer)Stats.Total);
+		lua_setfield(State, -2, "total");
+		lua_pushinteger(State, (lua_Integer)Stats.Peak);
+		lua_setfield(State, -2, "peak");
+		lua_pushinteger(State, (lua_Integer)Stats.Large);
+		lua_setfield(State, -2, "large");
+		lua_pushinteger(State, (lua_Integer)Stats.Reserved);
+		lua_setfield(State, -2, "reserved");
+
+		lua_createtable(State, Stats.Classes.Num(), 0);
+		for (int32 Index = 0; Index < Stats.Classes.Num(); ++Index) {
+			const LuaAllocatorStats::SizeClass& Class = Stats.Classes[Index];
+			lua_createtable(State, 0, 4);
+			lua_pushinteger(State, Class.Size);
+			lua_setfield(State, -2, "size");
+			lua_pushinteger(State, (lua_Integer)Class.Blocks);
+			lua_setfield(State, -2, "blocks");
+			lua_pushinteger(State, (lua_Integer)Class.Allocs);
+			lua_setfield(State, -2, "allocs");
+			lua_pushinteger(State, Class.Pages);
+			lua_setfield(State, -2, "pages");
+			lua_rawseti(State, -2, Index + 1);
 		}
-		return 0; // nil, nil, nil
+		lua_setfield(State, -2, "classes");
+
+		return 1;
 	}
 
 	// _cpp_struct_destroy(cobject, FStructProperty)
@@ -338,9 +596,7 @@ namespace TLua
 	static int CppEnumGetValue(lua_State* State)
 	{
 		UEnum* Type = (UEnum*)lua_touserdata(State, 1);
-		const char* AnsiName = (const char*)lua_tostring(State, 2);
-
-		FName Name(AnsiName);
+		FName Name = NameCache::Get().ToName(State, 2, ENameEncoding::Ansi);
 		int64 Value = Type->GetValueByName(Name);
 		lua_pushinteger(State, Value);
 
@@ -379,7 +635,7 @@ namespace TLua
 	// _cpp_new_object(UClass*)
 	int CppNewObject(lua_State* State)
 	{
-		UObject* Outter = (UObject*)lua_touserdata(State, 1);
+		UObject* Outter = GetValue<UObject*>(State, 1);
 		UClass* Class = (UClass*)lua_touserdata(State, 2);
 
 		UObject* Object = NewObject<UObject>(Outter, Class);
@@ -398,10 +654,19 @@ namespace TLua
 		return 1;
 	}
 
+	static UTLuaRootObject* GetRootObject(lua_State* State, int Index)
+	{
+		UTLuaRootObject* Root = Cast<UTLuaRootObject>(GetValue<UObject*>(State, Index));
+		if (!Root) {
+			luaL_error(State, "invalid root object");
+		}
+		return Root;
+	}
+
 	// _cpp_engine_callback(root_object, delta, fun)
 	int CppEngineCallback(lua_State* State)
 	{
-		UTLuaRootObject* Root = (UTLuaRootObject*)lua_touserdata(State, 1);
+		UTLuaRootObject* Root = GetRootObject(State, 1);
 		int Handler = Root->AddCallback(State);
 		lua_pushinteger(State, Handler);
 		return 1;
@@ -410,13 +675,97 @@ namespace TLua
 	// _cpp_engine_cancel_callback(root_object, handle)
 	int CppEngineCancelCallback(lua_State* State)
 	{
-		UTLuaRootObject* Root = (UTLuaRootObject*)lua_touserdata(State, 1);
+		UTLuaRootObject* Root = GetRootObject(State, 1);
 		int Handle = lua_tointeger(State, 2);
 		Root->CancelCallback(Handle);
 
 		return 0;
 	}
 
+	// _cpp_engine_add_timer(root_object, delay, interval, count, fun, owner) -> handle
+	int CppEngineAddTimer(lua_State* State)
+	{
+		UTLuaRootObject* Root = GetRootObject(State, 1);
+		double Delay = luaL_checknumber(State, 2);
+		double Interval = luaL_optnumber(State, 3, Delay);
+		int Count = (int)luaL_optinteger(State, 4, 0);
+		luaL_checktype(State, 5, LUA_TFUNCTION);
+		UObject* Owner = GetValue<UObject*>(State, 6);
+
+		lua_pushvalue(State, 5);
+		lua_pushinteger(State, Root->AddTimer(State, FCallbackMgr::ClockTime, Delay, Interval, Count, Owner));
+		return 1;
+	}
+
+	// _cpp_engine_add_frame_timer(root_object, frames, interval, count, fun, owner) -> handle
+	int CppEngineAddFrameTimer(lua_State* State)
+	{
+		UTLuaRootObject* Root = GetRootObject(State, 1);
+		lua_Integer Frames = luaL_checkinteger(State, 2);
+		lua_Integer Interval = luaL_optinteger(State, 3, Frames);
+		int Count = (int)luaL_optinteger(State, 4, 1);
+		luaL_checktype(State, 5, LUA_TFUNCTION);
+		UObject* Owner = GetValue<UObject*>(State, 6);
+
+		lua_pushvalue(State, 5);
+		lua_pushinteger(State, Root->AddTimer(State, FCallbackMgr::ClockFrame, (double)Frames, (double)Interval, Count, Owner));
+		return 1;
+	}
+
+	// _cpp_engine_next_frame(root_object, fun, owner) -> handle
+	int CppEngineNextFrame(lua_State* State)
+	{
+		UTLuaRootObject* Root = GetRootObject(State, 1);
+		luaL_checktype(State, 2, LUA_TFUNCTION);
+		UObject* Owner = GetValue<UObject*>(State, 3);
+
+		lua_pushvalue(State, 2);
+		lua_pushinteger(State, Root->AddTimer(State, FCallbackMgr::ClockFrame, 1., 1., 1, Owner));
+		return 1;
+	}
+
+	// _cpp_engine_cancel_owner_callbacks(root_object, owner) -> number
+	int CppEngineCancelOwnerCallbacks(lua_State* State)
+	{
+		UTLuaRootObject* Root = GetRootObject(State, 1);
+		UObject* Owner = GetValue<UObject*>(State, 2);
+
+		lua_pushinteger(State, Owner ? Root->CancelOwnerCallbacks(Owner) : 0);
+		return 1;
+	}
+
+	// _cpp_engine_add_tick(root_object, frames, fun) -> handle
+	int CppEngineAddTick(lua_State* State)
+	{
+		UTLuaRootObject* Root = GetRootObject(State, 1);
+		int Frames = (int)luaL_optinteger(State, 2, 1);
+		luaL_checktype(State, 3, LUA_TFUNCTION);
+
+		lua_settop(State, 3);
+		lua_pushinteger(State, Root->AddTick(State, Frames));
+		return 1;
+	}
+
+	// _cpp_engine_add_fixed_tick(root_object, hz, fun) -> handle
+	int CppEngineAddFixedTick(lua_State* State)
+	{
+		UTLuaRootObject* Root = GetRootObject(State, 1);
+		float Hz = (float)luaL_checknumber(State, 2);
+		luaL_checktype(State, 3, LUA_TFUNCTION);
+
+		lua_settop(State, 3);
+		lua_pushinteger(State, Root->AddFixedTick(State, Hz));
+		return 1;
+	}
+
+	// _cpp_engine_remove_tick(root_object, handle)
+	int CppEngineRemoveTick(lua_State* State)
+	{
+		UTLuaRootObject* Root = GetRootObject(State, 1);
+		Root->RemoveTick((int)lua_tointeger(State, 2));
+		return 0;
+	}
+
 	// _cpp_create_default_subobject(Object, Class.CameraComponent, FName)
 	int CppCreateDefaultSubobject(lua_State* State)
 	{
@@ -487,26 +836,6 @@ namespace TLua
 		return 0;
 	}
 
-	template <typename Type>
-	int CppFreeStruct(lua_State* State)
-	{
-		Type* Struct = (Type*)lua_touserdata(State, 1);
-		Struct->~Type();
-		return 0;
-	}
-
-	template <typename Type, typename ...ArgTypes>
-	void MakeStruct(lua_State* State, const ArgTypes... Args)
-	{
-		Type* Buffer = (Type*)lua_newuserdatauv(State, sizeof(Type), 0);
-		new(Buffer) Type(Args...);
-		// set userdata metatable
-		lua_newtable(State);							// type, metatable
-		lua_pushcfunction(State, CppFreeStruct<Type>);	// type, metatable, __gc
-		lua_setfield(State, -2, "__gc");				// type, metatable
-		lua_setmetatable(State, -2);					// type
-	}
-
 	// _cpp_make_vector(x, y, z) -> FVector
 	int CppMakeVector(lua_State* State)
 	{
@@ -514,7 +843,7 @@ namespace TLua
 		double Y = lua_tonumber(State, 2);
 		double Z = lua_tonumber(State, 3);
 
-		MakeStruct<FVector>(State, X, Y, Z);
+		PushValueType(State, FVector(X, Y, Z));
 		lua_pushlightuserdata(State, TBaseStructure<FVector>::Get()); // vector, ctype
 
 		return 2;
@@ -527,7 +856,8 @@ namespace TLua
 		double Y = lua_tonumber(State, 2);
 		double Z = lua_tonumber(State, 3);
 		double W = lua_tonumber(State, 4);
-		MakeStruct<FVector4>(State, X, Y, Z, W);
+		FVector4 Value(X, Y, Z, W);
+		PushStructCopy(State, TBaseStructure<FVector4>::Get(), &Value);
 		lua_pushlightuserdata(State, TBaseStructure<FVector4>::Get());
 		
 		return 2;
@@ -537,6 +867,13 @@ namespace TLua
 	{
 		lua_State* State = GetLuaState();
 
+		NameCache::Get().Attach(State);
+		RegisterString(State);
+		RegisterObjectProxy(State);
+		RegisterValueTypes(State);
+		RegisterStructProxy(State);
+		RegisterContainerView(State);
+
 		// blueprint function lib
 		lua_register(State, "_cpp_prepare_function_libs", CppPrepareFunctionLibs);
 		lua_register(State, "_cpp_prepare_subsystem", CppPrepareSubsystem);
@@ -552,12 +889,24 @@ namespace TLua
 		lua_register(State, "_cpp_get_engine", CppGetEngine);
 		lua_register(State, "_cpp_engine_callback", CppEngineCallback);
 		lua_register(State, "_cpp_engine_cancel_callback", CppEngineCancelCallback);
+		lua_register(State, "_cpp_engine_add_timer", CppEngineAddTimer);
+		lua_register(State, "_cpp_engine_add_frame_timer", CppEngineAddFrameTimer);
+		lua_register(State, "_cpp_engine_next_frame", CppEngineNextFrame);
+		lua_register(State, "_cpp_engine_cancel_owner_callbacks", CppEngineCancelOwnerCallbacks);
+		lua_register(State, "_cpp_engine_add_tick", CppEngineAddTick);
+		lua_register(State, "_cpp_engine_add_fixed_tick", CppEngineAddFixedTick);
+		lua_register(State, "_cpp_engine_remove_tick", CppEngineRemoveTick);
 
 		// struct
 		lua_register(State, "_cpp_struct_get_name", CppStructGetName);
 		lua_register(State, "_cpp_struct_get_info", CppStructGetInfo);
 		lua_register(State, "_cpp_struct_destroy", CppStructDestroy);
 
+		// member cache
+		lua_register(State, "_cpp_member_cache_stats", CppMemberCacheStats);
+		lua_register(State, "_cpp_name_cache_stats", CppNameCacheStats);
+		lua_register(State, "_cpp_allocator_stats", CppAllocatorStats);
+
 		// object
 		lua_register(State, "_cpp_object_get_name", CppObjectGetName);
 		lua_register(State, "_cpp_object_get_attrs", CppObjectGetAttrs);
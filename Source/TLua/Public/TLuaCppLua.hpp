@@ -6,29 +6,75 @@
 #include "TLuaCall.hpp"
 #include "TLuaProperty.hpp"
 
+// 1: invoke the thunk of the native UFunction directly,
+//    the net, blueprint event and script functions still go through ProcessEvent,
+//    so do the objects of the classes overriding ProcessEvent.
+// 0: always call UObject::ProcessEvent
+#ifndef TLUA_NATIVE_THUNK_CALL
+#define TLUA_NATIVE_THUNK_CALL 1
+#endif
+
 namespace TLua
 {
 	class FunctionContext
 	{
 	public:
 		FunctionContext(UFunction* InFunction);
+		~FunctionContext();
+
+		FunctionContext(const FunctionContext&) = delete;
+		FunctionContext& operator=(const FunctionContext&) = delete;
 
 		// _cpp_object_call(Object, Context, args...)
-		int Call(lua_State* State, UObject* Object);
-		void CallLua(int ExtraParameter, void* Parameters);
+		int Call(lua_State* State, UObject* Object, int ArgStartIndex = 3);
+		// stack: handler, fun
+		void CallLua(int Handler, void* Parameters);
 
 		void FillParameters(void* Parameters, lua_State* State, int ArgStartIndex);
 		int FreeParameter(void* Parameters, lua_State* State, int ArgStartIndex);
 
+		SIZE_T GetAllocatedSize() const;
+
+		// invoke the native thunk over the parameters, without ProcessEvent
+		void CallNative(UObject* Object, void* Parameters);
+
+		inline UFunction* GetFunction() const
+		{
+			return Function;
+		}
+
+		inline bool IsNativeCall() const
+		{
+			return bNativeCall;
+		}
+
 	private:
 		void ProcessParameterProperty();
 		void ProcessReturnProperty();
+		void ProcessLayout();
 
 	private:
 		UFunction* Function;
 		PropertyProcessor* Return;
 		ProcessorArray ParameterProcessors;
+
+		// the parameters initialized once, copied into the frame of every call
+		TArray<uint8> Template;
+		// parameters that can't live in the template, initialize them every call
+		TArray<int32> ConstructIndices;
+		// parameters need the destructor or copy back after the call
+		TArray<int32> FreeIndices;
+		bool bConstructReturn;
+		bool bDestroyReturn;
+
+		// the native thunk writes the out parameters through FFrame::OutParms
+		TArray<FProperty*> OutProperties;
+		bool bNativeCall;
 	};
 
+	// the objects of the native class overriding ProcessEvent are always called through it,
+	// UTLuaCallback is known, the gate of AActor is checked inline
+	TLua_API void AddProcessEventClass(const UClass* Class);
+
 	void RegisterCppLua();
 }
@@ -0,0 +1,244 @@
+#include "TLuaGC.hpp"
+
+#include "HAL/IConsoleManager.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+#include "TLua.h"
+#include "TLuaAllocator.hpp"
+#include "TLuaMemory.hpp"
+
+DECLARE_CYCLE_STAT(TEXT("Lua GC Step"), STAT_TLuaGCStep, STATGROUP_TLua);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Lua GC ms"), STAT_TLuaGCMs, STATGROUP_TLua);
+
+CSV_DECLARE_CATEGORY_EXTERN(TLua);
+
+static int32 GGCEnable = 1;
+static FAutoConsoleVariableRef CVarGCEnable(
+	TEXT("tlua.gc.Enable"),
+	GGCEnable,
+	TEXT("1: collect at the end of the frame within the budget, 0: the automatic collector of lua"));
+
+static int32 GGCBudgetUs = 1000;
+static FAutoConsoleVariableRef CVarGCBudgetUs(
+	TEXT("tlua.gc.BudgetUs"),
+	GGCBudgetUs,
+	TEXT("microseconds of the incremental steps per frame"));
+
+static int32 GGCPause = 200;
+static FAutoConsoleVariableRef CVarGCPause(
+	TEXT("tlua.gc.Pause"),
+	GGCPause,
+	TEXT("start a new cycle when the heap grows to this percent of the heap after the last cycle"));
+
+static float GGCMaxHeapRatio = 2.0f;
+static FAutoConsoleVariableRef CVarGCMaxHeapRatio(
+	TEXT("tlua.gc.MaxHeapRatio"),
+	GGCMaxHeapRatio,
+	TEXT("finish the cycle at once when the heap outgrows the threshold by this ratio"));
+
+static int32 GGCMode = 0;
+static FAutoConsoleVariableRef CVarGCMode(
+	TEXT("tlua.gc.Mode"),
+	GGCMode,
+	TEXT("0: switch by the allocation rate, 1: incremental, 2: generational"));
+
+static int32 GGCGenAllocKB = 512;
+static FAutoConsoleVariableRef CVarGCGenAllocKB(
+	TEXT("tlua.gc.GenAllocKB"),
+	GGCGenAllocKB,
+	TEXT("allocation rate (KB per frame) to switch to the generational mode, back to incremental under the half"));
+
+// switch the mode at most once in these frames, entering the generational mode is a full collection
+#define TLUA_GC_MODE_FRAMES 300
+// the steps stopped for these frames and seconds, restart the collector of lua
+#define TLUA_GC_STALL_FRAMES 30
+#define TLUA_GC_STALL_SECONDS 0.5
+// a minor collection after the heap grows by this percent (LUAI_GENMINORMUL)
+#define TLUA_GC_MINOR_PERCENT 20
+
+namespace TLua
+{
+	static inline SIZE_T GetHeapSize(lua_State* State)
+	{
+		return (SIZE_T)lua_gc(State, LUA_GCCOUNT) * 1024 + (SIZE_T)lua_gc(State, LUA_GCCOUNTB);
+	}
+
+	GCScheduler& GCScheduler::Get()
+	{
+		static GCScheduler Instance;
+		return Instance;
+	}
+
+	GCScheduler::GCScheduler()
+		: bAttached(false), bCollecting(false), LastFrame(0), LastStepTime(0.0), AttachedState(nullptr), Threshold(0),
+		LastTotal(0), AllocRate(0.0), FramesInMode(0)
+	{
+	}
+
+	void GCScheduler::Step(lua_State* State, float Delta)
+	{
+		if (LastFrame == GFrameCounter) {
+			return;
+		}
+		LastFrame = GFrameCounter;
+		LastStepTime = FPlatformTime::Seconds();
+
+		if (!GGCEnable) {
+			Detach(State);
+			return;
+		}
+		Attach(State);
+
+		SCOPE_CYCLE_COUNTER(STAT_TLuaGCStep);
+		double StartTime = FPlatformTime::Seconds();
+
+		SIZE_T Total = GetHeapSize(State);
+		UpdateMode(State, Total > LastTotal ? Total - LastTotal : 0);
+
+		if (Stats.bGenerational) {
+			StepGenerational(State, Total);
+		}
+		else {
+			StepIncremental(State, Total, StartTime + GGCBudgetUs * 1e-6);
+		}
+		LastTotal = GetHeapSize(State);
+
+		Stats.LastStepMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+		Stats.MaxStepMs = FMath::Max(Stats.MaxStepMs, Stats.LastStepMs);
+		SET_FLOAT_STAT(STAT_TLuaGCMs, Stats.LastStepMs);
+		CSV_CUSTOM_STAT(TLua, GCms, (float)Stats.LastStepMs, ECsvCustomStatOp::Set);
+	}
+
+	void GCScheduler::Attach(lua_State* State)
+	{
+		if (bAttached) {
+			return;
+		}
+
+		// the steps are only run by the scheduler, LUA_GCSTEP still works when stopped
+		lua_gc(State, LUA_GCSTOP);
+		bAttached = true;
+		bCollecting = false;
+		AttachedState = State;
+		LastTotal = GetHeapSize(State);
+		ResetThreshold(State);
+
+		// the core ticker runs without a world, paused or not
+		StallHandle = FTSTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateRaw(this, &GCScheduler::CheckStall));
+	}
+
+	void GCScheduler::Detach(lua_State* State)
+	{
+		if (!bAttached) {
+			return;
+		}
+
+		lua_gc(State, LUA_GCRESTART);
+		bAttached = false;
+		AttachedState = nullptr;
+		FTSTicker::GetCoreTicker().RemoveTicker(StallHandle);
+		StallHandle.Reset();
+	}
+
+	bool GCScheduler::CheckStall(float Delta)
+	{
+		if (!bAttached) {
+			return false;
+		}
+
+		if (GFrameCounter - LastFrame > TLUA_GC_STALL_FRAMES
+			&& FPlatformTime::Seconds() - LastStepTime > TLUA_GC_STALL_SECONDS) {
+			UE_LOG(Lua, Log, TEXT("lua gc: no steps since frame %llu, the collector of lua is restarted"), LastFrame);
+			Detach(AttachedState);
+			return false;
+		}
+		return true;
+	}
+
+	void GCScheduler::UpdateMode(lua_State* State, SIZE_T Allocated)
+	{
+		AllocRate = AllocRate * 0.9 + (double)Allocated * 0.1;
+		++FramesInMode;
+
+		bool bGenerational = Stats.bGenerational;
+		if (GGCMode == 1) {
+			bGenerational = false;
+		}
+		else if (GGCMode == 2) {
+			bGenerational = true;
+		}
+		else if (FramesInMode >= TLUA_GC_MODE_FRAMES) {
+			double Rate = (double)GGCGenAllocKB * 1024.0;
+			if (!bGenerational && AllocRate > Rate) {
+				bGenerational = true;
+			}
+			else if (bGenerational && AllocRate < Rate * 0.5) {
+				bGenerational = false;
+			}
+		}
+
+		if (bGenerational == Stats.bGenerational) {
+			return;
+		}
+
+		if (bGenerational) {
+			lua_gc(State, LUA_GCGEN, 0, 0);
+		}
+		else {
+			lua_gc(State, LUA_GCINC, 0, 0, 0);
+		}
+		Stats.bGenerational = bGenerational;
+		FramesInMode = 0;
+		bCollecting = false;
+		ResetThreshold(State);
+	}
+
+	void GCScheduler::StepIncremental(lua_State* State, SIZE_T Total, double EndTime)
+	{
+		if (!bCollecting && Total < Threshold) {
+			return;
+		}
+		bCollecting = true;
+
+		// fallen behind, finish the cycle at once rather than let the heap run away
+		if (Total > Threshold * GGCMaxHeapRatio) {
+			lua_gc(State, LUA_GCCOLLECT);
+			++Stats.FullCollections;
+#if TLUA_POOLED_ALLOCATOR
+			LuaAllocator::Get().Trim();
+#endif
+			bCollecting = false;
+			ResetThreshold(State);
+			return;
+		}
+
+		do {
+			if (lua_gc(State, LUA_GCSTEP, 0)) {
+				++Stats.Cycles;
+				bCollecting = false;
+				ResetThreshold(State);
+				return;
+			}
+		} while (FPlatformTime::Seconds() < EndTime);
+	}
+
+	// a minor collection can't be split, run one when the young objects add up
+	void GCScheduler::StepGenerational(lua_State* State, SIZE_T Total)
+	{
+		if (Total < Threshold) {
+			return;
+		}
+
+		lua_gc(State, LUA_GCSTEP, 0);
+		++Stats.MinorCollections;
+		ResetThreshold(State);
+	}
+
+	void GCScheduler::ResetThreshold(lua_State* State)
+	{
+		SIZE_T Total = GetHeapSize(State);
+		int32 Percent = Stats.bGenerational ? 100 + TLUA_GC_MINOR_PERCENT : FMath::Max(GGCPause, 100);
+		Threshold = Total / 100 * Percent;
+	}
+}
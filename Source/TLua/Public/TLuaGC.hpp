@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "Containers/Ticker.h"
+
+namespace TLua
+{
+	struct GCSchedulerStats
+	{
+		double LastStepMs = 0.0;
+		double MaxStepMs = 0.0;
+		int64 Cycles = 0;			// finished incremental cycles
+		int64 MinorCollections = 0;	// generational steps
+		int64 FullCollections = 0;	// the heap outgrew the incremental steps
+		bool bGenerational = false;
+	};
+
+	// the automatic collector is stopped, the collection steps run at the end of
+	// the frame within the budget of tlua.gc.BudgetUs. the mode switches to
+	// generational when the scripts allocate fast (tlua.gc.GenAllocKB per frame).
+	class TLua_API GCScheduler
+	{
+	public:
+		static GCScheduler& Get();
+
+		// once per frame, the later calls of the same frame are ignored
+		void Step(lua_State* State, float Delta);
+
+		// give the collection back to lua, the next Step takes it again
+		void Detach(lua_State* State);
+
+		inline const GCSchedulerStats& GetStats() const
+		{
+			return Stats;
+		}
+
+	private:
+		GCScheduler();
+
+		void Attach(lua_State* State);
+		// restart the collector of lua when the steps stopped (no world tick, map travel)
+		bool CheckStall(float Delta);
+		void UpdateMode(lua_State* State, SIZE_T Allocated);
+		void StepIncremental(lua_State* State, SIZE_T Total, double EndTime);
+		void StepGenerational(lua_State* State, SIZE_T Total);
+		void ResetThreshold(lua_State* State);
+
+	private:
+		bool bAttached;
+		bool bCollecting;
+		uint64 LastFrame;
+		double LastStepTime;
+		lua_State* AttachedState;
+		FTSTicker::FDelegateHandle StallHandle;
+
+		SIZE_T Threshold;			// start the cycle over this size
+		SIZE_T LastTotal;			// the heap after the last step
+		double AllocRate;			// smoothed bytes per frame
+		int32 FramesInMode;
+
+		GCSchedulerStats Stats;
+	};
+}
@@ -11,13 +11,80 @@
 #include "UObject/UObjectGlobals.h"
 
 #include "TLua.hpp"
+#include "TLuaAllocator.hpp"
+#include "TLuaBytecode.hpp"
 #include "TLuaCppLua.hpp"
 #include "TLuaTypes.hpp"
 
+// native message handler, append the traceback to the error message
+static int TraceHandler(lua_State* State)
+{
+	const char* Msg = lua_tostring(State, 1);
+	if (Msg == nullptr) {
+		if (luaL_callmeta(State, 1, "__tostring") && lua_type(State, -1) == LUA_TSTRING) {
+			return 1;
+		}
+		Msg = lua_pushfstring(State, "(error object is a %s value)", luaL_typename(State, 1));
+	}
+
+	luaL_traceback(State, State, Msg, 1);
+	return 1;
+}
+
+// warn(), off at the start as the one of luaL_newstate, "@on" / "@off" switch it.
+// the pieces of a message are joined until tocont is 0
+static bool bWarnOn = false;
+static bool bWarnCont = false;
+static FString WarnMessage;
+
+static void WarnHandler(void* UserData, const char* Message, int ToCont)
+{
+	if (!bWarnCont && !ToCont && Message[0] == '@') {
+		if (std::strcmp(Message, "@on") == 0) {
+			bWarnOn = true;
+		}
+		else if (std::strcmp(Message, "@off") == 0) {
+			bWarnOn = false;
+		}
+		return;
+	}
+
+	bWarnCont = ToCont != 0;
+	if (!bWarnOn) {
+		return;
+	}
+
+	WarnMessage += UTF8_TO_TCHAR(Message);
+	if (!ToCont) {
+		UE_LOG(Lua, Warning, TEXT("lua warning: %s"), *WarnMessage);
+		WarnMessage.Reset();
+	}
+}
+
+// unprotected error, nothing can be recovered
+static int PanicHandler(lua_State* State)
+{
+	const char* Msg = lua_tostring(State, -1);
+	UE_LOG(Lua, Fatal, TEXT("unprotected error in lua: %s"), Msg ? UTF8_TO_TCHAR(Msg) : TEXT("(error object is not a string)"));
+	return 0;
+}
+
 static inline lua_State* NewLuaState()
 {
+#if TLUA_POOLED_ALLOCATOR
+	lua_State* state = lua_newstate(&TLua::LuaAllocator::Alloc, &TLua::LuaAllocator::Get());
+#else
 	lua_State* state = luaL_newstate();
+#endif
+	lua_atpanic(state, PanicHandler);
+	// lua_newstate doesn't install the warn function, warn() would do nothing
+	lua_setwarnf(state, WarnHandler, nullptr);
 	luaL_openlibs(state);
+
+#if TLUA_NATIVE_TRACE_HANDLER
+	// TLUA_TRACE_HANDLER_INDEX, keep it at the bottom of the main thread
+	lua_pushcfunction(state, TraceHandler);
+#endif
 	return state;
 }
 
@@ -94,45 +161,62 @@ namespace TLua
 		return 1;
 	}
 
-	// _text function in lua
+	// _cpp_load_file(path, chunk_name) -> fun | nil, msg, through the bytecode cache
+	static int CppLoadFile(lua_State* State)
+	{
+		FString Path = TypeInfo<FString>::FromLua(State, 1);
+		const char* ChunkName = luaL_optstring(State, 2, "?");
+		if (BytecodeCache::Get().Load(State, Path, ChunkName)) {
+			return 1;
+		}
+
+		lua_pushnil(State);
+		lua_insert(State, -2);
+		return 2;
+	}
+
+	// _text function in lua, the string is unchanged with TLUA_STRING_UTF8
 	static int CppUTF8_TO_UTF16(lua_State* State)
 	{
+#if TLUA_STRING_UTF8
+		lua_settop(State, 1);
+#else
 		size_t utf8_size = 0;
 		UTF8CHAR* buff = (UTF8CHAR *)lua_tolstring(State, 1, &utf8_size);
 
 		FUTF8ToTCHAR converter(buff, utf8_size);
 		size_t size = converter.Length() * sizeof(TCHAR);
 		lua_pushlstring(State, (const char*)converter.Get(), size);
+#endif
 		return 1;
 	}
 
 	static int CppUTF16_TO_UTF8(lua_State* state)
 	{
+#if TLUA_STRING_UTF8
+		lua_settop(state, 1);
+#else
 		FString name = TypeInfo<FString>::FromLua(state, 1);
 		FTCHARToUTF8 converter(name);
 		lua_pushlstring(state, (const char*)converter.Get(), converter.Length());
+#endif
 		return 1;
 	}
 
-	static void LoadPrimaryLuaFile(lua_State* State, const FString& BaseName, const std::string& DisplayName)
+	// _cpp_invalidate_function_handles()
+	static int CppInvalidateFunctionHandles(lua_State* State)
 	{
-		TArray<uint8> Content;
-
-		if (!FFileHelper::LoadFileToArray(Content, *BaseName, FILEREAD_Silent)) {
-			UE_LOG(Lua, Error, TEXT("error while reading basic file:[%s]"), *BaseName);
-			return;
-		}
+		InvalidateFunctionHandles();
+		return 0;
+	}
 
-		Content.Add(0); // null byte
+	static void LoadPrimaryLuaFile(lua_State* State, const FString& BaseName, const std::string& DisplayName)
+	{
 		int RecoverIndex = lua_gettop(State);
-		lua_getglobal(State, "load");
-		int TopIndex = lua_gettop(State);
-		lua_pushlstring(State, (const char*)Content.GetData(), Content.NumBytes() - 1);
-		lua_pushstring(State, DisplayName.c_str());
-		lua_call(State, 2, LUA_MULTRET);
-		if (lua_isnoneornil(State, TopIndex)) {
+		int TopIndex = RecoverIndex + 1;
+		if (!BytecodeCache::Get().Load(State, BaseName, DisplayName.c_str())) {
 			FString Name(DisplayName.c_str()); // convert to utf16
-			FString Msg(lua_tostring(State, TopIndex + 1));
+			FString Msg(lua_tostring(State, TopIndex));
 			UE_LOG(Lua, Error, TEXT("Failed in load file[%s], %s"), *Name, *Msg);
 			lua_settop(State, RecoverIndex);
 			return;
@@ -156,10 +240,12 @@ namespace TLua
 		lua_register(state, "_lua_set_cpp_attr", LuaSetCppAttr); // internal use, don't re register this
 		lua_register(state, "_cpp_utf8_to_utf16", CppUTF8_TO_UTF16);
 		lua_register(state, "_cpp_utf16_to_utf8", CppUTF16_TO_UTF8);
+		lua_register(state, "_cpp_invalidate_function_handles", CppInvalidateFunctionHandles);
 		RegisterCppLua();
 
 		// lib hook, re register this functions when needed
 		lua_register(state, "_cpp_read_file", CppReadFile); // re register this after init when needed
+		lua_register(state, "_cpp_load_file", CppLoadFile); // re register this after init when needed
 		lua_register(state, "_cpp_log", LuaCppLog); // re register this after init when needed
 
 		FString basicFileName = FPaths::ProjectContentDir() / TEXT("Script/Lua/Libs/basic.lua");
@@ -179,13 +265,31 @@ namespace TLua
 		lua_State* state = GetLuaState();
 
 		FTCHARToUTF8 converter(FPaths::GetCleanFilename(name));
-		// call the dofile in lua
-		lua_getglobal(state, "trace_call");			// trace_call
-		lua_getglobal(state, "_lua_dofile");		// trace_call, _lua_dofile
-		PushValue(state, name);						// trace_call, _lua_dofile, name
-		lua_pushlstring(state, converter.Get(), converter.Length());
+		int Top = lua_gettop(state);
+		int Handler = LuaPushTraceHandler(state);	// handler
+
+		// the project hook keeps its environment and reload bookkeeping,
+		// it loads through the bytecode cache by _cpp_load_file
+		if (lua_getglobal(state, "_lua_dofile") == LUA_TFUNCTION) {	// handler, _lua_dofile
+			PushValue(state, name);						// handler, _lua_dofile, name
+			lua_pushlstring(state, converter.Get(), converter.Length());
+			LuaTraceCall(state, Handler, 2);
+		}
+		else {
+			lua_pop(state, 1);							// handler
+
+			// no hook, load through the bytecode cache, the prepared chunk at startup
+			if (BytecodeCache::Get().Load(state, name, converter.Get())) {	// handler, chunk
+				LuaTraceCall(state, Handler, 0);
+			}
+			else {
+				CheckState(LUA_ERRSYNTAX, state);
+				lua_settop(state, Top);
+			}
+		}
 
-		lua_call(state, 3, 0);
+		// the file may reassign the global functions
+		InvalidateFunctionHandles();
 	}
 
 	void DoString(const char* buffer, const char* name)
@@ -197,6 +301,8 @@ namespace TLua
 		{
 			LuaCall(state, 0, 0);
 		}
+
+		InvalidateFunctionHandles();
 	}
 
 	void RegisterCallbackImp(const char* name, void* processor, void* callback)
@@ -234,6 +340,43 @@ namespace TLua
 		}
 	}
 
+	int LuaPushTraceHandler(lua_State* State)
+	{
+#if TLUA_NATIVE_TRACE_HANDLER
+		lua_Debug Ar;
+		if (!lua_getstack(State, 0, &Ar)) {
+			// no active function, the permanent handler is visible
+			return TLUA_TRACE_HANDLER_INDEX;
+		}
+		lua_pushcfunction(State, TraceHandler);
+#else
+		lua_getglobal(State, TLUA_TRACE_CALL_NAME);
+#endif
+		return lua_gettop(State);
+	}
+
+	void LuaTraceCall(lua_State* State, int Handler, int ArgNum, int ReturnNum)
+	{
+#if TLUA_NATIVE_TRACE_HANDLER
+		int Result = lua_pcall(State, ArgNum, ReturnNum, Handler);
+		if (Result != LUA_OK) {
+			CheckState(Result, State);
+			lua_pop(State, 1);
+			// keep the stack balanced for the caller
+			for (int Index = 0; Index < ReturnNum; ++Index) {
+				lua_pushnil(State);
+			}
+		}
+
+		if (Handler != TLUA_TRACE_HANDLER_INDEX) {
+			lua_remove(State, Handler);
+		}
+#else
+		// trace_call(fun, args...)
+		LuaCall(State, ArgNum + 1, ReturnNum);
+#endif
+	}
+
 	int LuaGetTop(lua_State* state)
 	{
 		return lua_gettop(state);
@@ -4,6 +4,16 @@
 
 #define TLUA_TRACE_CALL_NAME "trace_call"
 
+// 1: pass a native traceback handler as the message handler of lua_pcall,
+//    the target function is called directly.
+// 0: call the target through the lua side trace_call(fun, args...)
+#ifndef TLUA_NATIVE_TRACE_HANDLER
+#define TLUA_NATIVE_TRACE_HANDLER 1
+#endif
+
+// the native handler sits permanently at this slot of the main thread
+#define TLUA_TRACE_HANDLER_INDEX 1
+
 namespace TLua
 {
 	TLua_API void Init();
@@ -15,6 +25,10 @@ namespace TLua
 	TLua_API void LuaGetGlobal(lua_State* state, const char* name);
 	TLua_API void LuaCall(lua_State* state, int ArgNum, int ReturnNum = 0);
 	TLua_API void LuaPCall(lua_State* State, int ArgNum, int ReturnNum = 0);
+	// push the message handler, return the handler index for LuaTraceCall
+	TLua_API int LuaPushTraceHandler(lua_State* State);
+	// stack: handler, ..., fun, args... -> ..., results
+	TLua_API void LuaTraceCall(lua_State* State, int Handler, int ArgNum, int ReturnNum = 0);
 	TLua_API int LuaGetTop(lua_State* state);
 	TLua_API void LuaError(lua_State* state, const char* msg);
 	TLua_API void LuaCheckStack(lua_State* State, int Num);
@@ -0,0 +1,303 @@
+#include "TLuaMemberCache.hpp"
+
+#include <atomic>
+
+#include "Containers/BitArray.h"
+#include "Misc/ScopeLock.h"
+#include "UObject/UObjectArray.h"
+
+#include "TLuaObjectProxy.hpp"
+#include "TLuaStructProxy.hpp"
+
+namespace TLua
+{
+	// drop the cached entries of the deleted UStruct before the address is reused
+	class FMemberCacheListener : public FUObjectArray::FUObjectDeleteListener
+	{
+	public:
+		FMemberCacheListener() : Registered(false), HasPending(false)
+		{
+		}
+
+		void Track(const UStruct* Struct)
+		{
+			if (!Registered) {
+				GUObjectArray.AddUObjectDeleteListener(this);
+				Registered = true;
+			}
+
+			int32 ObjectIndex = GUObjectArray.ObjectToIndex(Struct);
+			if (ObjectIndex >= Tracked.Num()) {
+				Tracked.Add(false, ObjectIndex + 1 - Tracked.Num());
+			}
+			Tracked[ObjectIndex] = true;
+		}
+
+		virtual void NotifyUObjectDeleted(const UObjectBase* Object, int32 Index) override
+		{
+			if (!IsInGameThread()) {
+				FScopeLock Lock(&PendingLock);
+				Pending.Add(TPair<const UObjectBase*, int32>(Object, Index));
+				HasPending = true;
+				return;
+			}
+
+			Deleted(Object, Index);
+		}
+
+		virtual void OnUObjectArrayShutdown() override
+		{
+			GUObjectArray.RemoveUObjectDeleteListener(this);
+			Registered = false;
+		}
+
+		void FlushPending()
+		{
+			if (!HasPending) {
+				return;
+			}
+
+			TArray<TPair<const UObjectBase*, int32>> Objects;
+			{
+				FScopeLock Lock(&PendingLock);
+				Objects = MoveTemp(Pending);
+				HasPending = false;
+			}
+
+			for (const auto& Pair : Objects) {
+				Deleted(Pair.Key, Pair.Value);
+			}
+		}
+
+	private:
+		void Deleted(const UObjectBase* Object, int32 Index)
+		{
+			if (Index >= Tracked.Num() || !Tracked[Index]) {
+				return;
+			}
+			Tracked[Index] = false;
+
+			// the tracked object is an UStruct, only the address is used
+			MemberCache::Get().OnStructDeleted(static_cast<const UStruct*>(Object));
+		}
+
+	private:
+		bool Registered;
+		// object index -> have a cache entry or a metatable
+		TBitArray<> Tracked;
+
+		FCriticalSection PendingLock;
+		TArray<TPair<const UObjectBase*, int32>> Pending;
+		std::atomic<bool> HasPending;
+	};
+
+	static FMemberCacheListener CacheListener;
+
+	MemberCache& MemberCache::Get()
+	{
+		static MemberCache Instance;
+		return Instance;
+	}
+
+	MemberCache::MemberCache()
+		: Hits(0), Misses(0), MemberNum(0), Memory(0)
+	{
+#if WITH_EDITOR
+		// the blueprint compiler rebuild the properties of the class
+		FCoreUObjectDelegates::OnObjectsReplaced.AddRaw(this, &MemberCache::OnObjectsReplaced);
+#endif
+	}
+
+	MemberCache::~MemberCache()
+	{
+		Clear();
+	}
+
+	const MemberInfo& MemberCache::Find(UStruct* Struct, FName Name)
+	{
+		CacheListener.FlushPending();
+
+		StructMembers* Existing = Structs.Find(Struct);
+		if (!Existing) {
+			Track(Struct);
+			Existing = &Structs.Add(Struct);
+		}
+		StructMembers& Members = *Existing;
+		if (const MemberInfo* Info = Members.Find(Name)) {
+			++Hits;
+			return *Info;
+		}
+
+		++Misses;
+		++MemberNum;
+
+		// the missing member is cached too
+		MemberInfo Info = CreateMember(Struct, Name);
+		Memory += GetMemberSize(Info);
+
+		return Members.Add(Name, Info);
+	}
+
+	void MemberCache::Invalidate(const UStruct* Struct)
+	{
+		// the sub classes share the members of the super
+		TArray<const UStruct*> Invalid;
+		for (auto& Pair : Structs) {
+			if (Pair.Key->IsChildOf(Struct)) {
+				Retire(Pair.Value);
+				Invalid.Add(Pair.Key);
+			}
+		}
+		if (Invalid.Num() == 0) {
+			return;
+		}
+
+		for (const UStruct* Key : Invalid) {
+			Structs.Remove(Key);
+		}
+
+		// the metatables cache the retired processors
+		lua_State* State = GetLuaState();
+		ResetProxyMembers(State, Struct);
+		ResetStructMembers(State, Struct);
+	}
+
+	void MemberCache::Track(const UStruct* Struct)
+	{
+		CacheListener.Track(Struct);
+	}
+
+	void MemberCache::FlushDeleted()
+	{
+		CacheListener.FlushPending();
+	}
+
+	void MemberCache::OnStructDeleted(const UStruct* Struct)
+	{
+		if (StructMembers* Members = Structs.Find(Struct)) {
+			Retire(*Members);
+			Structs.Remove(Struct);
+		}
+
+		// the sub structs are deleted with it, only the exact entries go
+		lua_State* State = GetLuaState();
+		RemoveProxyMetatable(State, Struct);
+		RemoveStructMetatable(State, Struct);
+	}
+
+	void MemberCache::Clear()
+	{
+		for (auto& Pair : Structs) {
+			for (auto& Member : Pair.Value) {
+				FreeMember(Member.Value);
+			}
+		}
+		Structs.Empty();
+
+		for (const MemberInfo& Info : Retired) {
+			FreeMember(Info);
+		}
+		Retired.Empty();
+
+		MemberNum = 0;
+		Memory = 0;
+	}
+
+	MemberCacheStats MemberCache::GetStats() const
+	{
+		MemberCacheStats Stats;
+		Stats.Hits = Hits;
+		Stats.Misses = Misses;
+		Stats.Members = MemberNum;
+
+		Stats.Memory = Memory + Structs.GetAllocatedSize() + Retired.GetAllocatedSize();
+		for (const auto& Pair : Structs) {
+			Stats.Memory += Pair.Value.GetAllocatedSize();
+		}
+
+		return Stats;
+	}
+
+	MemberInfo MemberCache::CreateMember(UStruct* Struct, FName Name)
+	{
+		MemberInfo Info;
+
+		FProperty* Property = Struct->FindPropertyByName(Name);
+		if (Property) {
+			Info.Processor = CreatePropertyProcessor(Property);
+			return Info;
+		}
+
+		// only class have the UFunction
+		UClass* Class = Cast<UClass>(Struct);
+		if (!Class) {
+			return Info;
+		}
+
+		UFunction* Function = Class->FindFunctionByName(Name);
+		if (Function) {
+			Info.Function = new FunctionContext(Function);
+		}
+
+		return Info;
+	}
+
+	void MemberCache::Retire(StructMembers& Members)
+	{
+		// keep the memory alive, lua may still reference them
+		for (auto& Member : Members) {
+			if (Member.Value.Processor || Member.Value.Function) {
+				Retired.Add(Member.Value);
+			}
+		}
+		MemberNum -= Members.Num();
+	}
+
+	void MemberCache::FreeMember(const MemberInfo& Info)
+	{
+		delete Info.Processor;
+		delete Info.Function;
+	}
+
+	SIZE_T MemberCache::GetMemberSize(const MemberInfo& Info) const
+	{
+		if (Info.Processor) {
+			return Info.Processor->GetAllocatedSize();
+		}
+		if (Info.Function) {
+			return Info.Function->GetAllocatedSize();
+		}
+		return 0;
+	}
+
+#if WITH_EDITOR
+	void MemberCache::OnObjectsReplaced(const TMap<UObject*, UObject*>& ReplacedMap)
+	{
+		if (Structs.Num() == 0) {
+			return;
+		}
+
+		// only the structs and the CDOs tell a recompiled type, the instances
+		// of the native classes are reinstanced too
+		TSet<const UStruct*> Replaced;
+		for (const auto& Pair : ReplacedMap) {
+			for (UObject* Object : { Pair.Key, Pair.Value }) {
+				if (!Object) {
+					continue;
+				}
+
+				if (UStruct* Struct = Cast<UStruct>(Object)) {
+					Replaced.Add(Struct);
+				}
+				else if (Object->HasAnyFlags(RF_ClassDefaultObject)) {
+					Replaced.Add(Object->GetClass());
+				}
+			}
+		}
+
+		for (const UStruct* Struct : Replaced) {
+			Invalidate(Struct);
+		}
+	}
+#endif
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/UObjectGlobals.h"
+
+#include "TLuaCppLua.hpp"
+#include "TLuaProperty.hpp"
+
+namespace TLua
+{
+	// the member of a UStruct, at most one of them is valid
+	struct MemberInfo
+	{
+		PropertyProcessor* Processor = nullptr;
+		FunctionContext* Function = nullptr;
+	};
+
+	struct MemberCacheStats
+	{
+		uint64 Hits = 0;
+		uint64 Misses = 0;
+		int32 Members = 0;
+		SIZE_T Memory = 0;
+
+		inline double GetHitRate() const
+		{
+			uint64 Total = Hits + Misses;
+			return Total ? (double)Hits / (double)Total : 0.0;
+		}
+	};
+
+	// one shared PropertyProcessor or FunctionContext per (UStruct, FName)
+	class TLua_API MemberCache
+	{
+		using StructMembers = TMap<FName, MemberInfo>;
+	public:
+		static MemberCache& Get();
+
+		~MemberCache();
+
+		const MemberInfo& Find(UStruct* Struct, FName Name);
+		// drop the members of the struct and the sub structs, reset the proxy
+		// metatables referencing them (the blueprint class is recompiled)
+		void Invalidate(const UStruct* Struct);
+		void Clear();
+
+		// the cache and the proxy metatables are keyed by the raw pointer, drop the
+		// entries of the struct when UE delete it (level streaming, plugin unload)
+		void Track(const UStruct* Struct);
+		// handle the structs deleted out of the game thread
+		void FlushDeleted();
+
+		MemberCacheStats GetStats() const;
+
+	private:
+		MemberCache();
+
+		friend class FMemberCacheListener;
+		void OnStructDeleted(const UStruct* Struct);
+
+		MemberInfo CreateMember(UStruct* Struct, FName Name);
+		void Retire(StructMembers& Members);
+		void FreeMember(const MemberInfo& Info);
+		SIZE_T GetMemberSize(const MemberInfo& Info) const;
+
+#if WITH_EDITOR
+		void OnObjectsReplaced(const TMap<UObject*, UObject*>& ReplacedMap);
+#endif
+
+	private:
+		TMap<const UStruct*, StructMembers> Structs;
+		// lua may still hold the pointers of the invalidated members (the info
+		// lightuserdata, the bound callbacks), freed only by Clear
+		TArray<MemberInfo> Retired;
+
+		uint64 Hits;
+		uint64 Misses;
+		int32 MemberNum;
+		SIZE_T Memory;
+	};
+}
@@ -0,0 +1,216 @@
+#include "TLuaMemory.hpp"
+
+#include "HAL/IConsoleManager.h"
+#include "Misc/OutputDevice.h"
+#include "Misc/Parse.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+#include "TLuaAllocator.hpp"
+
+DECLARE_MEMORY_STAT(TEXT("Lua Heap"), STAT_TLuaHeap, STATGROUP_TLua);
+// the debt is negative until the next step is due
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Lua GC Debt KB"), STAT_TLuaGCDebt, STATGROUP_TLua);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lua Tables"), STAT_TLuaTables, STATGROUP_TLua);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lua Functions"), STAT_TLuaFunctions, STATGROUP_TLua);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lua Userdata"), STAT_TLuaUserdata, STATGROUP_TLua);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lua Strings"), STAT_TLuaStrings, STATGROUP_TLua);
+
+CSV_DEFINE_CATEGORY(TLua, true);
+
+static float GCountObjectsInterval = 1.0f;
+static FAutoConsoleVariableRef CVarCountObjectsInterval(
+	TEXT("tlua.mem.CountInterval"),
+	GCountObjectsInterval,
+	TEXT("seconds between the counts of the lua objects in the memory stats, 0 disables the counts"));
+
+namespace TLua
+{
+	static const TCHAR* ObjectTypeNames[LUA_NUMOBJECTTYPES] = {
+		TEXT("nil"), TEXT("boolean"), TEXT("lightuserdata"), TEXT("number"), TEXT("string"),
+		TEXT("table"), TEXT("function"), TEXT("userdata"), TEXT("thread"), TEXT("upvalue"), TEXT("proto")
+	};
+
+	LuaMemoryStats GetMemoryStats(lua_State* State, bool CountObjects)
+	{
+		LuaMemoryStats Stats;
+		Stats.Total = (SIZE_T)lua_gc(State, LUA_GCCOUNT) * 1024 + (SIZE_T)lua_gc(State, LUA_GCCOUNTB);
+		Stats.Debt = (int64)lua_getgcdebt(State);
+
+		if (CountObjects) {
+			size_t Counts[LUA_NUMOBJECTTYPES];
+			lua_countobjects(State, Counts);
+			for (int Type = 0; Type < LUA_NUMOBJECTTYPES; ++Type) {
+				Stats.Objects[Type] = Counts[Type];
+			}
+			Stats.bObjectsCounted = true;
+		}
+		return Stats;
+	}
+
+	void UpdateMemoryStats(lua_State* State, float Delta)
+	{
+#if STATS || CSV_PROFILER
+		// counting walks all the objects, not every frame
+		static float CountElapsed = 0.0f;
+		CountElapsed += Delta;
+		bool CountObjects = GCountObjectsInterval > 0.0f && CountElapsed >= GCountObjectsInterval;
+		if (CountObjects) {
+			CountElapsed = 0.0f;
+		}
+
+		LuaMemoryStats Stats = GetMemoryStats(State, CountObjects);
+
+		SET_MEMORY_STAT(STAT_TLuaHeap, Stats.Total);
+		SET_FLOAT_STAT(STAT_TLuaGCDebt, (float)((double)Stats.Debt / 1024.0));
+		CSV_CUSTOM_STAT(TLua, HeapMB, (float)((double)Stats.Total / (1024.0 * 1024.0)), ECsvCustomStatOp::Set);
+		CSV_CUSTOM_STAT(TLua, GCDebtKB, (float)((double)Stats.Debt / 1024.0), ECsvCustomStatOp::Set);
+
+		if (Stats.bObjectsCounted) {
+			SET_DWORD_STAT(STAT_TLuaTables, Stats.Objects[LUA_TTABLE]);
+			SET_DWORD_STAT(STAT_TLuaFunctions, Stats.Objects[LUA_TFUNCTION]);
+			SET_DWORD_STAT(STAT_TLuaUserdata, Stats.Objects[LUA_TUSERDATA]);
+			SET_DWORD_STAT(STAT_TLuaStrings, Stats.Objects[LUA_TSTRING]);
+			CSV_CUSTOM_STAT(TLua, Tables, (int32)Stats.Objects[LUA_TTABLE], ECsvCustomStatOp::Set);
+			CSV_CUSTOM_STAT(TLua, Functions, (int32)Stats.Objects[LUA_TFUNCTION], ECsvCustomStatOp::Set);
+			CSV_CUSTOM_STAT(TLua, Userdata, (int32)Stats.Objects[LUA_TUSERDATA], ECsvCustomStatOp::Set);
+			CSV_CUSTOM_STAT(TLua, Strings, (int32)Stats.Objects[LUA_TSTRING], ECsvCustomStatOp::Set);
+		}
+#endif
+	}
+
+	AllocationSampler& AllocationSampler::Get()
+	{
+		static AllocationSampler Instance;
+		return Instance;
+	}
+
+	AllocationSampler::AllocationSampler()
+		: Interval(0), Countdown(0), bRunning(false)
+	{
+	}
+
+	void AllocationSampler::Start(lua_State* State, int64 InInterval)
+	{
+		Interval = FMath::Max<int64>(InInterval, 1);
+		Countdown = Interval;
+		bRunning = true;
+		lua_setallocsamplef(State, &AllocationSampler::OnAlloc, this);
+	}
+
+	void AllocationSampler::Stop(lua_State* State)
+	{
+		lua_setallocsamplef(State, nullptr, nullptr);
+		bRunning = false;
+	}
+
+	void AllocationSampler::Reset()
+	{
+		Sites.Empty();
+		Countdown = Interval;
+	}
+
+	TArray<TPair<FString, int64>> AllocationSampler::GetSites(int32 Num) const
+	{
+		TArray<TPair<FString, int64>> Result;
+		Result.Reserve(Sites.Num());
+		for (const auto& Site : Sites) {
+			Result.Emplace(Site.Key, Site.Value);
+		}
+
+		Result.Sort([](const TPair<FString, int64>& A, const TPair<FString, int64>& B) {
+			return A.Value > B.Value;
+		});
+		if (Num >= 0 && Result.Num() > Num) {
+			Result.SetNum(Num);
+		}
+		return Result;
+	}
+
+	// called inside the allocation of the new block, only reads the stack
+	void AllocationSampler::OnAlloc(void* UserData, lua_State* State, size_t Size)
+	{
+		AllocationSampler* Sampler = (AllocationSampler*)UserData;
+		Sampler->Countdown -= (int64)Size;
+		if (Sampler->Countdown > 0) {
+			return;
+		}
+
+		// a big block may cover several samples
+		int64 Samples = -Sampler->Countdown / Sampler->Interval + 1;
+		Sampler->Countdown += Samples * Sampler->Interval;
+
+		// the innermost lua function, the c functions allocate for their caller
+		lua_Debug Ar;
+		FString Site(TEXT("[C]"));
+		for (int Level = 0; lua_getstack(State, Level, &Ar); ++Level) {
+			lua_getinfo(State, "Sl", &Ar);
+			if (Ar.currentline >= 0) {
+				Site = FString::Printf(TEXT("%s:%d"), UTF8_TO_TCHAR(Ar.short_src), Ar.currentline);
+				break;
+			}
+		}
+
+		Sampler->Sites.FindOrAdd(Site) += Samples * Sampler->Interval;
+	}
+
+	static void DumpSites(FOutputDevice& Ar, int32 Num)
+	{
+		AllocationSampler& Sampler = AllocationSampler::Get();
+
+		Ar.Logf(TEXT("allocation sites (sampler %s):"), Sampler.IsRunning() ? TEXT("on") : TEXT("off"));
+		for (const auto& Site : Sampler.GetSites(Num)) {
+			Ar.Logf(TEXT("  %10lld  %s"), Site.Value, *Site.Key);
+		}
+	}
+
+	static void DumpMemory(lua_State* State, FOutputDevice& Ar)
+	{
+		LuaMemoryStats Stats = GetMemoryStats(State, true);
+		Ar.Logf(TEXT("lua heap: %llu bytes, gc debt: %lld bytes"), (uint64)Stats.Total, Stats.Debt);
+		for (int Type = 0; Type < LUA_NUMOBJECTTYPES; ++Type) {
+			if (Stats.Objects[Type] > 0) {
+				Ar.Logf(TEXT("  %-14s %llu"), ObjectTypeNames[Type], (uint64)Stats.Objects[Type]);
+			}
+		}
+
+#if TLUA_POOLED_ALLOCATOR
+		LuaAllocatorStats Pools = LuaAllocator::Get().GetStats();
+		Ar.Logf(TEXT("allocator: peak %llu, large %llu (%lld blocks), reserved %llu"),
+			(uint64)Pools.Peak, (uint64)Pools.Large, Pools.LargeBlocks, (uint64)Pools.Reserved);
+		for (const LuaAllocatorStats::SizeClass& Class : Pools.Classes) {
+			Ar.Logf(TEXT("  %4d bytes: %lld blocks, %d pages"), Class.Size, Class.Blocks, Class.Pages);
+		}
+#endif
+
+		DumpSites(Ar, 20);
+	}
+
+	void ExecMemoryCommand(lua_State* State, const TCHAR* Cmd, FOutputDevice& Ar)
+	{
+		if (FParse::Command(&Cmd, TEXT("sample"))) {
+			FString Token = FParse::Token(Cmd, false);
+			int64 Interval = Token.IsEmpty() ? 64 * 1024 : FCString::Atoi64(*Token);
+			AllocationSampler::Get().Start(State, Interval);
+			Ar.Logf(TEXT("allocation sampler: one sample per %lld bytes"), Interval);
+		}
+		else if (FParse::Command(&Cmd, TEXT("stop"))) {
+			AllocationSampler::Get().Stop(State);
+		}
+		else if (FParse::Command(&Cmd, TEXT("reset"))) {
+			AllocationSampler::Get().Reset();
+		}
+		else if (FParse::Command(&Cmd, TEXT("sites"))) {
+			FString Token = FParse::Token(Cmd, false);
+			DumpSites(Ar, Token.IsEmpty() ? 20 : FCString::Atoi(*Token));
+		}
+#if TLUA_POOLED_ALLOCATOR
+		else if (FParse::Command(&Cmd, TEXT("trim"))) {
+			lua_gc(State, LUA_GCCOLLECT);
+			Ar.Logf(TEXT("allocator: %d pages released"), LuaAllocator::Get().Trim());
+		}
+#endif
+		else {
+			DumpMemory(State, Ar);
+		}
+	}
+}
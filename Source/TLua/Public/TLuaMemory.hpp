@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("TLua"), STATGROUP_TLua, STATCAT_Advanced);
+
+namespace TLua
+{
+	struct LuaMemoryStats
+	{
+		SIZE_T Total = 0;
+		int64 Debt = 0;
+		// collectable objects by the basic type, upvalues and prototypes at the end
+		SIZE_T Objects[LUA_NUMOBJECTTYPES] = {};
+		bool bObjectsCounted = false;
+	};
+
+	// CountObjects walks all the objects of the state
+	TLua_API LuaMemoryStats GetMemoryStats(lua_State* State, bool CountObjects);
+
+	// called once per frame, feed the UE stats and the csv profiler
+	TLua_API void UpdateMemoryStats(lua_State* State, float Delta);
+
+	// attribute the bytes of the new and grown blocks to the running lua source:line,
+	// one sample for every Interval bytes
+	class TLua_API AllocationSampler
+	{
+	public:
+		static AllocationSampler& Get();
+
+		void Start(lua_State* State, int64 InInterval);
+		void Stop(lua_State* State);
+		void Reset();
+
+		inline bool IsRunning() const
+		{
+			return bRunning;
+		}
+
+		// the top sites by the bytes
+		TArray<TPair<FString, int64>> GetSites(int32 Num) const;
+
+	private:
+		AllocationSampler();
+
+		static void OnAlloc(void* UserData, lua_State* State, size_t Size);
+
+	private:
+		TMap<FString, int64> Sites;
+		int64 Interval;
+		int64 Countdown;
+		bool bRunning;
+	};
+
+	// lua mem [sample <bytes> | stop | reset | sites <num> | trim]
+	TLua_API void ExecMemoryCommand(lua_State* State, const TCHAR* Cmd, FOutputDevice& Ar);
+}
@@ -0,0 +1,86 @@
+#include "TLuaNameCache.hpp"
+
+#include "TLuaString.hpp"
+
+namespace TLua
+{
+	NameCache& NameCache::Get()
+	{
+		static NameCache Instance;
+		return Instance;
+	}
+
+	NameCache::NameCache()
+		: NameNum(0), Hits(0), Misses(0)
+	{
+	}
+
+	void NameCache::Attach(lua_State* State)
+	{
+		Clear();
+		lua_setstringfreef(State, &NameCache::OnStringFree, this);
+	}
+
+	FName NameCache::ToName(lua_State* State, int Index, ENameEncoding Encoding)
+	{
+		size_t Size = 0;
+		const char* Buffer = lua_tointernedstring(State, Index, &Size);
+		if (!Buffer) {
+			// the long string is not interned, nothing to key
+			Buffer = lua_tolstring(State, Index, &Size);
+			return Buffer ? MakeName(Buffer, Size, Encoding) : NAME_None;
+		}
+
+		NameMap& Map = Names[(int)Encoding];
+		if (const FName* Name = Map.Find(Buffer)) {
+			++Hits;
+			return *Name;
+		}
+
+		++Misses;
+		++NameNum;
+		return Map.Add(Buffer, MakeName(Buffer, Size, Encoding));
+	}
+
+	void NameCache::Clear()
+	{
+		for (NameMap& Map : Names) {
+			Map.Empty();
+		}
+		NameNum = 0;
+	}
+
+	NameCacheStats NameCache::GetStats() const
+	{
+		NameCacheStats Stats;
+		Stats.Hits = Hits;
+		Stats.Misses = Misses;
+		Stats.Names = NameNum;
+		return Stats;
+	}
+
+	FName NameCache::MakeName(const char* Buffer, size_t Size, ENameEncoding Encoding)
+	{
+		if (Encoding == ENameEncoding::Tchar) {
+			return FName((int32)(Size / sizeof(TCHAR)), (const TCHAR*)Buffer);
+		}
+		if (Encoding == ENameEncoding::Utf8 && !IsAscii(Buffer, Size)) {
+			FUTF8ToTCHAR Convert((const UTF8CHAR*)Buffer, (int32)Size);
+			return FName(Convert.Length(), Convert.Get());
+		}
+		return FName((int32)Size, Buffer);
+	}
+
+	// called by the gc for every freed short string, keep it cheap
+	void NameCache::OnStringFree(void* UserData, const char* String)
+	{
+		NameCache* Cache = (NameCache*)UserData;
+		if (Cache->NameNum == 0) {
+			return;
+		}
+
+		for (NameMap& Map : Cache->Names) {
+			Cache->NameNum -= Map.Remove(String);
+		}
+	}
+}
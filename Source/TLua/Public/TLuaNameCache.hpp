@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "UObject/NameTypes.h"
+
+namespace TLua
+{
+	// how the bytes of the lua string are read as the name
+	enum class ENameEncoding : uint8
+	{
+		Ansi,		// the member names from the scripts
+		Tchar,		// TypeInfo<FName>, the raw TCHAR buffer
+		Utf8,		// TypeInfo<FName> with TLUA_STRING_UTF8
+		Num
+	};
+
+	struct NameCacheStats
+	{
+		uint64 Hits = 0;
+		uint64 Misses = 0;
+		int32 Names = 0;
+
+		inline double GetHitRate() const
+		{
+			uint64 Total = Hits + Misses;
+			return Total ? (double)Hits / (double)Total : 0.0;
+		}
+	};
+
+	// FName of the interned (short) lua strings, keyed by the address of the string.
+	// the entry is dropped when lua frees the string, the address may be reused.
+	class TLua_API NameCache
+	{
+		using NameMap = TMap<const char*, FName>;
+	public:
+		static NameCache& Get();
+
+		// hook the string free of the state, must be called before any lookup
+		void Attach(lua_State* State);
+
+		FName ToName(lua_State* State, int Index, ENameEncoding Encoding);
+		void Clear();
+
+		NameCacheStats GetStats() const;
+
+	private:
+		NameCache();
+
+		static FName MakeName(const char* Buffer, size_t Size, ENameEncoding Encoding);
+		static void OnStringFree(void* UserData, const char* String);
+
+	private:
+		NameMap Names[(int)ENameEncoding::Num];
+		int32 NameNum;
+
+		uint64 Hits;
+		uint64 Misses;
+	};
+}
@@ -0,0 +1,492 @@
+#include "TLuaObjectProxy.hpp"
+
+#include <atomic>
+#include <cstring>
+
+#include "TLua.h"
+#include "TLuaContainerView.hpp"
+#include "TLuaCppLua.hpp"
+#include "TLuaMemberCache.hpp"
+#include "TLuaProfiler.hpp"
+#include "TLuaTrace.hpp"
+
+#include "Containers/BitArray.h"
+#include "Misc/ScopeLock.h"
+#include "UObject/UObjectArray.h"
+
+// metatable slots of the proxy
+#define TLUA_PROXY_MEMBERS_INDEX 1	// name -> processor | closure | false
+#define TLUA_PROXY_CLASS_INDEX 2	// lua side class table
+#define TLUA_PROXY_CTYPE_INDEX 3	// UClass*
+
+namespace TLua
+{
+	// registry[&MetatablesKey] = { [UClass*] = metatable }
+	static char MetatablesKey;
+	// metatable[&ObjectProxyTag] = true
+	static char ObjectProxyTag;
+	// registry[&ProxiesKey] = { [UObject*] = proxy }, weak values
+	static char ProxiesKey;
+
+	// drop the proxy when UE delete the object, keep the cache bounded
+	class FObjectProxyListener : public FUObjectArray::FUObjectDeleteListener
+	{
+	public:
+		FObjectProxyListener() : Registered(false), HasPending(false)
+		{
+		}
+
+		void Register()
+		{
+			if (!Registered) {
+				GUObjectArray.AddUObjectDeleteListener(this);
+				Registered = true;
+			}
+		}
+
+		inline void MarkProxied(int32 ObjectIndex)
+		{
+			if (ObjectIndex >= Proxied.Num()) {
+				Proxied.Add(false, ObjectIndex + 1 - Proxied.Num());
+			}
+			Proxied[ObjectIndex] = true;
+		}
+
+		virtual void NotifyUObjectDeleted(const UObjectBase* Object, int32 Index) override
+		{
+			if (!IsInGameThread()) {
+				// touch lua in the game thread only
+				FScopeLock Lock(&PendingLock);
+				Pending.Add(TPair<const UObjectBase*, int32>(Object, Index));
+				HasPending = true;
+				return;
+			}
+
+			Invalidate(Object, Index);
+		}
+
+		virtual void OnUObjectArrayShutdown() override
+		{
+			GUObjectArray.RemoveUObjectDeleteListener(this);
+			Registered = false;
+		}
+
+		void FlushPending()
+		{
+			if (!HasPending) {
+				return;
+			}
+
+			TArray<TPair<const UObjectBase*, int32>> Deleted;
+			{
+				FScopeLock Lock(&PendingLock);
+				Deleted = MoveTemp(Pending);
+				HasPending = false;
+			}
+
+			for (const auto& Pair : Deleted) {
+				Invalidate(Pair.Key, Pair.Value);
+			}
+		}
+
+	private:
+		void Invalidate(const UObjectBase* Object, int32 Index)
+		{
+			if (Index >= Proxied.Num() || !Proxied[Index]) {
+				return;
+			}
+			Proxied[Index] = false;
+
+			lua_State* State = GetLuaState();
+			lua_rawgetp(State, LUA_REGISTRYINDEX, &ProxiesKey);		// proxies
+			if (lua_rawgetp(State, -1, Object) == LUA_TUSERDATA) {		// proxies, proxy
+				ObjectProxy* Proxy = (ObjectProxy*)lua_touserdata(State, -1);
+				Proxy->Object = nullptr;
+
+				lua_pushnil(State);
+				lua_rawsetp(State, -3, Object);
+			}
+			lua_pop(State, 2);
+		}
+
+	private:
+		bool Registered;
+		// object index -> have a proxy in the cache
+		TBitArray<> Proxied;
+
+		FCriticalSection PendingLock;
+		TArray<TPair<const UObjectBase*, int32>> Pending;
+		std::atomic<bool> HasPending;
+	};
+
+	static FObjectProxyListener ProxyListener;
+
+	static UObject* ResolveProxy(const ObjectProxy* Proxy)
+	{
+		if (!Proxy->Object) {
+			return nullptr;
+		}
+
+		FUObjectItem* Item = GUObjectArray.IndexToObject(Proxy->ObjectIndex);
+		if (!Item || Item->SerialNumber != Proxy->SerialNumber || Item->Object != Proxy->Object) {
+			return nullptr;
+		}
+
+		return IsValid(Proxy->Object) ? Proxy->Object : nullptr;
+	}
+
+	// _proxy_fun(self, args...)
+	static int CppProxyCallFun(lua_State* State)
+	{
+		UObject* Object = GetProxyObject(State, 1);
+		if (!Object) {
+			return luaL_error(State, "call function on invalid object");
+		}
+
+		FunctionContext* Context = (FunctionContext*)lua_touserdata(State, lua_upvalueindex(1));
+		return Context->Call(State, Object, 2);
+	}
+
+	// stack: proxy, key, ... -> ..., member
+	// member: PropertyProcessor(lightuserdata) | function | false
+	static int PushMember(lua_State* State, int MetaIndex)
+	{
+		lua_rawgeti(State, MetaIndex, TLUA_PROXY_MEMBERS_INDEX);	// members
+		lua_pushvalue(State, 2);
+		int Type = lua_rawget(State, -2);							// members, member
+		if (Type != LUA_TNIL) {
+			lua_remove(State, -2);
+			return Type;
+		}
+		lua_pop(State, 1);											// members
+
+		if (lua_type(State, 2) != LUA_TSTRING) {
+			lua_pop(State, 1);
+			lua_pushboolean(State, 0);
+			return LUA_TBOOLEAN;
+		}
+
+		lua_rawgeti(State, MetaIndex, TLUA_PROXY_CTYPE_INDEX);
+		UClass* Class = (UClass*)lua_touserdata(State, -1);
+		lua_pop(State, 1);
+
+		const MemberInfo& Info = MemberCache::Get().Find(Class, FName(lua_tostring(State, 2)));
+		if (Info.Processor) {
+			lua_pushlightuserdata(State, Info.Processor);
+		}
+		else if (Info.Function) {
+			lua_pushlightuserdata(State, Info.Function);
+			lua_pushcclosure(State, CppProxyCallFun, 1);
+		}
+		else {
+			lua_pushboolean(State, 0);
+		}
+
+		lua_pushvalue(State, 2);									// members, member, key
+		lua_pushvalue(State, -2);									// members, member, key, member
+		lua_rawset(State, -4);										// members, member
+		lua_remove(State, -2);										// member
+
+		return lua_type(State, -1);
+	}
+
+	// __index(proxy, key)
+	static int CppProxyIndex(lua_State* State)
+	{
+		lua_settop(State, 2);
+
+		// the lua side fields of the instance
+		if (lua_getiuservalue(State, 1, 1) == LUA_TTABLE) {		// proxy, key, fields
+			lua_pushvalue(State, 2);
+			if (lua_rawget(State, 3) != LUA_TNIL) {
+				return 1;
+			}
+		}
+		lua_settop(State, 2);
+
+		lua_getmetatable(State, 1);									// proxy, key, mt
+
+		// the lua side class
+		if (lua_rawgeti(State, 3, TLUA_PROXY_CLASS_INDEX) == LUA_TTABLE) {
+			lua_pushvalue(State, 2);
+			if (lua_gettable(State, 4) != LUA_TNIL) {
+				return 1;
+			}
+		}
+		lua_settop(State, 3);
+
+		int Type = PushMember(State, 3);							// proxy, key, mt, member
+		if (Type == LUA_TFUNCTION) {
+			return 1;
+		}
+
+		ObjectProxy* Proxy = (ObjectProxy*)lua_touserdata(State, 1);
+		UObject* Object = ResolveProxy(Proxy);
+
+		if (Type == LUA_TLIGHTUSERDATA) {
+			if (!Object) {
+				return luaL_error(State, "attempt to index a invalid object with '%s'", lua_tostring(State, 2));
+			}
+
+			PropertyProcessor* Processor = (PropertyProcessor*)lua_touserdata(State, 4);
+			TLUA_TRACE_SCOPE(Processor->Property, false);
+			ProfilerScope Scope(State, EProfilerBoundary::GetProperty, Processor);
+			Processor->ToLua(State, Object);
+			BindOwner(State, 1);
+			return 1;
+		}
+
+		// compatible with the scripts use the raw pointer
+		if (lua_type(State, 2) == LUA_TSTRING && strcmp(lua_tostring(State, 2), "_co") == 0) {
+			lua_pushlightuserdata(State, Object);
+			return 1;
+		}
+
+		lua_pushnil(State);
+		return 1;
+	}
+
+	// __newindex(proxy, key, value)
+	static int CppProxyNewIndex(lua_State* State)
+	{
+		lua_settop(State, 3);
+		lua_getmetatable(State, 1);									// proxy, key, value, mt
+
+		if (PushMember(State, 4) == LUA_TLIGHTUSERDATA) {			// proxy, key, value, mt, member
+			UObject* Object = ResolveProxy((ObjectProxy*)lua_touserdata(State, 1));
+			if (!Object) {
+				return luaL_error(State, "attempt to index a invalid object with '%s'", lua_tostring(State, 2));
+			}
+
+			PropertyProcessor* Processor = (PropertyProcessor*)lua_touserdata(State, 5);
+			Processor->FromLuaTraced(State, 3, Object);
+			return 0;
+		}
+		lua_settop(State, 3);
+
+		// not a property, save to the lua side fields
+		if (lua_getiuservalue(State, 1, 1) != LUA_TTABLE) {		// proxy, key, value, fields
+			lua_pop(State, 1);
+			lua_newtable(State);
+			lua_pushvalue(State, -1);
+			lua_setiuservalue(State, 1, 1);
+		}
+
+		lua_pushvalue(State, 2);
+		lua_pushvalue(State, 3);
+		lua_rawset(State, 4);
+
+		return 0;
+	}
+
+	// __eq(proxy, proxy)
+	static int CppProxyEq(lua_State* State)
+	{
+		ObjectProxy* Left = ToObjectProxy(State, 1);
+		ObjectProxy* Right = ToObjectProxy(State, 2);
+
+		lua_pushboolean(State, Left && Right && Left->Object == Right->Object);
+		return 1;
+	}
+
+	// __tostring(proxy)
+	static int CppProxyToString(lua_State* State)
+	{
+		ObjectProxy* Proxy = (ObjectProxy*)lua_touserdata(State, 1);
+		UObject* Object = ResolveProxy(Proxy);
+		if (!Object) {
+			lua_pushfstring(State, "invalid object: %p", Proxy->Object);
+			return 1;
+		}
+
+		FTCHARToUTF8 Convert(Object->GetName());
+		lua_pushfstring(State, "%s: %p", (const char*)Convert.Get(), Object);
+		return 1;
+	}
+
+	// stack: ..., metatables -> ..., metatables, metatable
+	static void NewClassMetatable(lua_State* State, UClass* Class)
+	{
+		lua_createtable(State, 3, 6);
+
+		lua_pushboolean(State, 1);
+		lua_rawsetp(State, -2, &ObjectProxyTag);
+
+		lua_newtable(State);
+		lua_rawseti(State, -2, TLUA_PROXY_MEMBERS_INDEX);
+
+		// inherit the lua side class from the nearest super class
+		int Top = lua_gettop(State);								// metatables, mt
+		for (UClass* Super = Class->GetSuperClass(); Super; Super = Super->GetSuperClass()) {
+			if (lua_rawgetp(State, Top - 1, Super) == LUA_TTABLE		// metatables, mt, super_mt
+				&& lua_rawgeti(State, -1, TLUA_PROXY_CLASS_INDEX) == LUA_TTABLE) {
+				lua_rawseti(State, Top, TLUA_PROXY_CLASS_INDEX);
+				lua_settop(State, Top);
+				break;
+			}
+			lua_settop(State, Top);
+		}
+
+		lua_pushlightuserdata(State, Class);
+		lua_rawseti(State, -2, TLUA_PROXY_CTYPE_INDEX);
+
+		FTCHARToUTF8 Convert(Class->GetName());
+		lua_pushlstring(State, (const char*)Convert.Get(), Convert.Length());
+		lua_setfield(State, -2, "__name");
+
+		lua_pushcfunction(State, CppProxyIndex);
+		lua_setfield(State, -2, "__index");
+		lua_pushcfunction(State, CppProxyNewIndex);
+		lua_setfield(State, -2, "__newindex");
+		lua_pushcfunction(State, CppProxyEq);
+		lua_setfield(State, -2, "__eq");
+		lua_pushcfunction(State, CppProxyToString);
+		lua_setfield(State, -2, "__tostring");
+	}
+
+	// stack: ... -> ..., metatable
+	static void PushClassMetatable(lua_State* State, UClass* Class)
+	{
+		lua_rawgetp(State, LUA_REGISTRYINDEX, &MetatablesKey);		// metatables
+		if (lua_rawgetp(State, -1, Class) != LUA_TTABLE) {			// metatables, mt
+			lua_pop(State, 1);
+			MemberCache::Get().Track(Class);
+			NewClassMetatable(State, Class);
+			lua_pushvalue(State, -1);
+			lua_rawsetp(State, -3, Class);
+		}
+		lua_remove(State, -2);										// mt
+	}
+
+	void RemoveProxyMetatable(lua_State* State, const UStruct* Struct)
+	{
+		if (lua_rawgetp(State, LUA_REGISTRYINDEX, &MetatablesKey) == LUA_TTABLE) {
+			lua_pushnil(State);
+			lua_rawsetp(State, -2, Struct);
+		}
+		lua_pop(State, 1);
+	}
+
+	void ResetProxyMembers(lua_State* State, const UStruct* Struct)
+	{
+		if (lua_rawgetp(State, LUA_REGISTRYINDEX, &MetatablesKey) != LUA_TTABLE) {
+			lua_pop(State, 1);
+			return;
+		}
+
+		lua_pushnil(State);											// metatables, nil
+		while (lua_next(State, -2)) {								// metatables, class, mt
+			const UClass* Class = (const UClass*)lua_touserdata(State, -2);
+			if (Class->IsChildOf(Struct)) {
+				lua_newtable(State);
+				lua_rawseti(State, -2, TLUA_PROXY_MEMBERS_INDEX);
+			}
+			lua_pop(State, 1);										// metatables, class
+		}
+		lua_pop(State, 1);
+	}
+
+	void PushObjectProxy(lua_State* State, UObject* Object)
+	{
+		if (!Object) {
+			lua_pushnil(State);
+			return;
+		}
+
+		ProxyListener.FlushPending();
+		MemberCache::Get().FlushDeleted();
+
+		lua_rawgetp(State, LUA_REGISTRYINDEX, &ProxiesKey);			// proxies
+		if (lua_rawgetp(State, -1, Object) == LUA_TUSERDATA			// proxies, proxy
+			&& ResolveProxy((ObjectProxy*)lua_touserdata(State, -1)) == Object) {
+			lua_remove(State, -2);									// proxy
+			return;
+		}
+		lua_pop(State, 1);											// proxies
+
+		ObjectProxy* Proxy = (ObjectProxy*)lua_newuserdatauv(State, sizeof(ObjectProxy), 1);
+		Proxy->Object = Object;
+		Proxy->ObjectIndex = GUObjectArray.ObjectToIndex(Object);
+		Proxy->SerialNumber = GUObjectArray.AllocateSerialNumber(Proxy->ObjectIndex);
+
+		PushClassMetatable(State, Object->GetClass());
+		lua_setmetatable(State, -2);								// proxies, proxy
+
+		lua_pushvalue(State, -1);
+		lua_rawsetp(State, -3, Object);								// proxies, proxy
+		lua_remove(State, -2);										// proxy
+
+		ProxyListener.MarkProxied(Proxy->ObjectIndex);
+	}
+
+	ObjectProxy* ToObjectProxy(lua_State* State, int Index)
+	{
+		if (lua_type(State, Index) != LUA_TUSERDATA || !lua_getmetatable(State, Index)) {
+			return nullptr;
+		}
+
+		lua_rawgetp(State, -1, &ObjectProxyTag);
+		bool IsProxy = lua_toboolean(State, -1);
+		lua_pop(State, 2);
+
+		return IsProxy ? (ObjectProxy*)lua_touserdata(State, Index) : nullptr;
+	}
+
+	UObject* GetProxyObject(lua_State* State, int Index)
+	{
+		ObjectProxy* Proxy = ToObjectProxy(State, Index);
+		return Proxy ? ResolveProxy(Proxy) : nullptr;
+	}
+
+	// _cpp_object_proxy(object) -> proxy
+	static int CppObjectProxy(lua_State* State)
+	{
+		PushObjectProxy(State, (UObject*)lua_touserdata(State, 1));
+		return 1;
+	}
+
+	// _cpp_proxy_get_object(proxy) -> object
+	static int CppProxyGetObject(lua_State* State)
+	{
+		UObject* Object = GetProxyObject(State, 1);
+		if (!Object) {
+			return 0;
+		}
+
+		lua_pushlightuserdata(State, Object);
+		return 1;
+	}
+
+	// _cpp_proxy_set_class(ctype, class)
+	static int CppProxySetClass(lua_State* State)
+	{
+		UClass* Class = (UClass*)lua_touserdata(State, 1);
+		lua_settop(State, 2);
+
+		PushClassMetatable(State, Class);							// ctype, class, mt
+		lua_pushvalue(State, 2);
+		lua_rawseti(State, 3, TLUA_PROXY_CLASS_INDEX);
+
+		return 0;
+	}
+
+	void RegisterObjectProxy(lua_State* State)
+	{
+		lua_newtable(State);
+		lua_rawsetp(State, LUA_REGISTRYINDEX, &MetatablesKey);
+
+		// the proxy is alive only when lua reference it
+		lua_newtable(State);										// proxies
+		lua_createtable(State, 0, 1);								// proxies, mt
+		lua_pushstring(State, "v");
+		lua_setfield(State, -2, "__mode");
+		lua_setmetatable(State, -2);								// proxies
+		lua_rawsetp(State, LUA_REGISTRYINDEX, &ProxiesKey);
+
+		ProxyListener.Register();
+
+		lua_register(State, "_cpp_object_proxy", CppObjectProxy);
+		lua_register(State, "_cpp_proxy_get_object", CppProxyGetObject);
+		lua_register(State, "_cpp_proxy_set_class", CppProxySetClass);
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "UObject/UObjectGlobals.h"
+
+namespace TLua
+{
+	// full userdata of the UObject, shared the metatable with the same UClass.
+	// user value 1: table of the lua side fields, created on demand.
+	struct ObjectProxy
+	{
+		UObject* Object;
+		int32 ObjectIndex;
+		int32 SerialNumber;
+	};
+
+	// push the proxy of the object, nil for nullptr
+	TLua_API void PushObjectProxy(lua_State* State, UObject* Object);
+
+	// return the proxy at the index, nullptr if it's not a proxy
+	TLua_API ObjectProxy* ToObjectProxy(lua_State* State, int Index);
+
+	// return the object of the proxy, nullptr if it's not a proxy or the object is dead
+	TLua_API UObject* GetProxyObject(lua_State* State, int Index);
+
+	// drop the members cached in the metatables of the class and the sub classes,
+	// they are resolved again on the next access
+	void ResetProxyMembers(lua_State* State, const UStruct* Struct);
+
+	// drop the metatable of the deleted class
+	void RemoveProxyMetatable(lua_State* State, const UStruct* Struct);
+
+	void RegisterObjectProxy(lua_State* State);
+}
@@ -0,0 +1,284 @@
+#include "TLuaProfiler.hpp"
+
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/OutputDevice.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+
+#include "TLuaProperty.hpp"
+#include "TLuaTrace.hpp"
+
+UE_TRACE_EVENT_BEGIN(TLua, ProfilerSample)
+	UE_TRACE_EVENT_FIELD(uint64, Cycle)
+	UE_TRACE_EVENT_FIELD(uint32, Weight)
+	UE_TRACE_EVENT_FIELD(UE::Trace::WideString, Stack)
+UE_TRACE_EVENT_END()
+
+// samples in the queue, drained when it's half full
+#define TLUA_PROFILER_QUEUE_SIZE 1024
+
+namespace TLua
+{
+	bool Profiler::bRunning = false;
+
+	Profiler& Profiler::Get()
+	{
+		static Profiler Instance;
+		return Instance;
+	}
+
+	Profiler::Profiler()
+		: Period(0), NextSample(0), Samples(TLUA_PROFILER_QUEUE_SIZE)
+	{
+	}
+
+	void Profiler::Start(lua_State* State, int32 Hz, int32 InstructionCount)
+	{
+		Period = (uint64)(1.0 / (FPlatformTime::GetSecondsPerCycle64() * FMath::Max(Hz, 1)));
+		NextSample = FPlatformTime::Cycles64() + Period;
+		Boundaries.Reset();
+		bRunning = true;
+
+		lua_sethook(State, &Profiler::Hook, LUA_MASKCOUNT, FMath::Max(InstructionCount, 1));
+	}
+
+	void Profiler::Stop(lua_State* State)
+	{
+		lua_sethook(State, nullptr, 0, 0);
+		bRunning = false;
+		Boundaries.Reset();
+		Drain();
+	}
+
+	void Profiler::Reset()
+	{
+		Drain();
+		Stacks.Empty();
+	}
+
+	FString Profiler::ExportCollapsed()
+	{
+		Drain();
+
+		FString Result;
+		for (const auto& Stack : Stacks) {
+			Result += FString::Printf(TEXT("%s %llu\n"), *Stack.Key, Stack.Value);
+		}
+		return Result;
+	}
+
+	void Profiler::PushBoundary(lua_State* State, EProfilerBoundary Kind, const void* Target)
+	{
+		int32 Depth = 0;
+		lua_Debug Ar;
+		while (lua_getstack(State, Depth, &Ar)) {
+			++Depth;
+		}
+
+		Boundaries.Add(Boundary{ State, (uint64)(UPTRINT)Target | (uint64)Kind, Depth });
+	}
+
+	void Profiler::PopBoundary()
+	{
+		if (Boundaries.Num() == 0) {
+			return;
+		}
+
+		// the time in the native code has no hook, take the due sample here
+		uint64 Now = FPlatformTime::Cycles64();
+		if (Now >= NextSample) {
+			uint32 Weight = (uint32)((Now - NextSample) / Period) + 1;
+			NextSample = Now + Period;
+			Capture(Boundaries.Last().State, Weight);
+		}
+
+		Boundaries.Pop();
+	}
+
+	void Profiler::Hook(lua_State* State, lua_Debug* Ar)
+	{
+		// the coroutine created while profiling keeps the hook after Stop
+		if (!bRunning) {
+			lua_sethook(State, nullptr, 0, 0);
+			return;
+		}
+
+		Profiler& Self = Get();
+
+		uint64 Now = FPlatformTime::Cycles64();
+		if (Now < Self.NextSample) {
+			return;
+		}
+
+		uint32 Weight = (uint32)((Now - Self.NextSample) / Self.Period) + 1;
+		Self.NextSample = Now + Self.Period;
+		Self.Capture(State, Weight);
+	}
+
+	void Profiler::Capture(lua_State* State, uint32 Weight)
+	{
+		// innermost first
+		uint32 LuaFrames[MaxDepth];
+		int32 Levels = 0;
+		lua_Debug Ar;
+		while (Levels < MaxDepth && lua_getstack(State, Levels, &Ar)) {
+			lua_getinfo(State, "Sn", &Ar);
+			LuaFrames[Levels++] = InternFrame(Ar);
+		}
+
+		// a lua error longjmps over the scope, drop the boundaries the stack has left
+		while (Boundaries.Num() > 0 && Boundaries.Last().State == State && Boundaries.Last().Depth > Levels && Levels < MaxDepth) {
+			Boundaries.Pop();
+		}
+
+		// outermost first, the boundaries sit above the lua levels they were entered at
+		Sample Current;
+		Current.Weight = Weight;
+		Current.Num = 0;
+
+		int32 BoundaryIndex = 0;
+		auto AddBoundaries = [&](int32 Depth) {
+			for (; BoundaryIndex < Boundaries.Num(); ++BoundaryIndex) {
+				const Boundary& Each = Boundaries[BoundaryIndex];
+				if (Each.State != State) {
+					continue;
+				}
+				if (Each.Depth > Depth || Current.Num >= MaxDepth) {
+					break;
+				}
+				Current.Frames[Current.Num++] = InternBoundary(Each.Key);
+			}
+		};
+
+		AddBoundaries(0);
+		for (int32 Level = Levels - 1; Level >= 0 && Current.Num < MaxDepth; --Level) {
+			Current.Frames[Current.Num++] = LuaFrames[Level];
+			AddBoundaries(Levels - Level);
+		}
+
+		if (UE_TRACE_CHANNELEXPR_IS_ENABLED(TLuaChannel)) {
+			FString Stack;
+			for (int32 Index = 0; Index < Current.Num; ++Index) {
+				if (Index > 0) {
+					Stack += TEXT(";");
+				}
+				Stack += Names[Current.Frames[Index]];
+			}
+
+			UE_TRACE_LOG(TLua, ProfilerSample, TLuaChannel)
+				<< ProfilerSample.Cycle(FPlatformTime::Cycles64())
+				<< ProfilerSample.Weight(Weight)
+				<< ProfilerSample.Stack(*Stack, Stack.Len());
+		}
+
+		if (Samples.Count() >= TLUA_PROFILER_QUEUE_SIZE / 2) {
+			Drain();
+		}
+		Samples.Enqueue(Current);
+	}
+
+	void Profiler::Drain()
+	{
+		Sample Current;
+		while (Samples.Dequeue(Current)) {
+			FString Stack;
+			for (int32 Index = 0; Index < Current.Num; ++Index) {
+				if (Index > 0) {
+					Stack += TEXT(";");
+				}
+				Stack += Names[Current.Frames[Index]];
+			}
+			Stacks.FindOrAdd(Stack) += Current.Weight;
+		}
+	}
+
+	uint32 Profiler::InternFrame(const lua_Debug& Ar)
+	{
+		FString Source = UTF8_TO_TCHAR(Ar.short_src);
+		FString Name = Ar.name ? UTF8_TO_TCHAR(Ar.name) : TEXT("?");
+
+		if (Ar.what && FCStringAnsi::Strcmp(Ar.what, "C") == 0) {
+			return InternName(FString::Printf(TEXT("[C] %s"), *Name));
+		}
+		if (Ar.what && FCStringAnsi::Strcmp(Ar.what, "main") == 0) {
+			return InternName(FString::Printf(TEXT("main (%s)"), *Source));
+		}
+		return InternName(FString::Printf(TEXT("%s (%s:%d)"), *Name, *Source, Ar.linedefined));
+	}
+
+	uint32 Profiler::InternBoundary(uint64 Key)
+	{
+		if (const uint32* Id = BoundaryIds.Find(Key)) {
+			return *Id;
+		}
+
+		EProfilerBoundary Kind = (EProfilerBoundary)(Key & 3);
+		const void* Target = (const void*)(UPTRINT)(Key & ~(uint64)3);
+
+		FString Name;
+		if (Kind == EProfilerBoundary::Function) {
+			const UFunction* Function = (const UFunction*)Target;
+			Name = FString::Printf(TEXT("[UFunction] %s::%s"), *Function->GetOuter()->GetName(), *Function->GetName());
+		}
+		else {
+			const PropertyProcessor* Processor = (const PropertyProcessor*)Target;
+			Name = FString::Printf(TEXT("[%s] %s"),
+				Kind == EProfilerBoundary::GetProperty ? TEXT("Get") : TEXT("Set"), *Processor->Property->GetName());
+		}
+
+		uint32 Id = InternName(Name);
+		BoundaryIds.Add(Key, Id);
+		return Id;
+	}
+
+	uint32 Profiler::InternName(const FString& Name)
+	{
+		if (const uint32* Id = NameIds.Find(Name)) {
+			return *Id;
+		}
+
+		uint32 Id = (uint32)Names.Add(Name);
+		NameIds.Add(Name, Id);
+		return Id;
+	}
+
+	void ExecProfilerCommand(lua_State* State, const TCHAR* Cmd, FOutputDevice& Ar)
+	{
+		Profiler& Target = Profiler::Get();
+
+		if (FParse::Command(&Cmd, TEXT("start"))) {
+			FString HzToken = FParse::Token(Cmd, false);
+			FString CountToken = FParse::Token(Cmd, false);
+			int32 Hz = HzToken.IsEmpty() ? 1000 : FCString::Atoi(*HzToken);
+			int32 Count = CountToken.IsEmpty() ? 1000 : FCString::Atoi(*CountToken);
+
+			Target.Start(State, Hz, Count);
+			Ar.Logf(TEXT("lua profiler: %d Hz, the hook every %d instructions"), Hz, Count);
+		}
+		else if (FParse::Command(&Cmd, TEXT("stop"))) {
+			Target.Stop(State);
+		}
+		else if (FParse::Command(&Cmd, TEXT("reset"))) {
+			Target.Reset();
+		}
+		else if (FParse::Command(&Cmd, TEXT("dump"))) {
+			FString Path = FParse::Token(Cmd, false);
+			if (Path.IsEmpty()) {
+				Path = FPaths::ProfilingDir() / TEXT("TLua") / FString::Printf(TEXT("lua-%s.folded"), *FDateTime::Now().ToString());
+			}
+
+			if (FFileHelper::SaveStringToFile(Target.ExportCollapsed(), *Path)) {
+				Ar.Logf(TEXT("lua profiler: collapsed stacks saved to %s"), *Path);
+			}
+			else {
+				Ar.Logf(TEXT("lua profiler: failed to write %s"), *Path);
+			}
+		}
+		else {
+			Ar.Logf(TEXT("lua profile [start <hz> <count> | stop | reset | dump <path>], %s"),
+				Profiler::IsRunning() ? TEXT("running") : TEXT("stopped"));
+		}
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "Containers/CircularQueue.h"
+
+namespace TLua
+{
+	// the c++ frame between the lua frames in the samples
+	enum class EProfilerBoundary : uint8
+	{
+		Function,		// UFunction*
+		GetProperty,	// PropertyProcessor*
+		SetProperty,	// PropertyProcessor*
+	};
+
+	// sampling profiler on the count hook: every InstructionCount instructions the hook
+	// checks the clock, and captures the lua stack once per sample period.
+	// the hook is set on the given state, the coroutines created later inherit it, the
+	// ones created before Start are never sampled. Stop unhooks the state, the inherited
+	// hooks remove themselves on their next call.
+	class TLua_API Profiler
+	{
+	public:
+		static constexpr int32 MaxDepth = 64;
+
+		static Profiler& Get();
+
+		static inline bool IsRunning()
+		{
+			return bRunning;
+		}
+
+		void Start(lua_State* State, int32 Hz, int32 InstructionCount);
+		void Stop(lua_State* State);
+		void Reset();
+
+		// aggregated samples as the collapsed stacks, "outer;...;inner weight" per line
+		FString ExportCollapsed();
+
+		void PushBoundary(lua_State* State, EProfilerBoundary Kind, const void* Target);
+		void PopBoundary();
+
+	private:
+		struct Boundary
+		{
+			lua_State* State;
+			uint64 Key;
+			int32 Depth;	// lua levels under the boundary
+		};
+
+		struct Sample
+		{
+			uint32 Weight;
+			int32 Num;
+			uint32 Frames[MaxDepth];	// outermost first
+		};
+
+		Profiler();
+
+		static void Hook(lua_State* State, lua_Debug* Ar);
+
+		// the sample is due, Weight: the sample periods passed
+		void Capture(lua_State* State, uint32 Weight);
+		void Drain();
+
+		uint32 InternFrame(const lua_Debug& Ar);
+		uint32 InternBoundary(uint64 Key);
+		uint32 InternName(const FString& Name);
+
+	private:
+		static bool bRunning;
+
+		uint64 Period;			// cycles
+		uint64 NextSample;
+
+		// single producer (the hook), drained on the same thread before it fills
+		TCircularQueue<Sample> Samples;
+		TMap<FString, uint64> Stacks;
+
+		TArray<Boundary> Boundaries;
+		TMap<FString, uint32> NameIds;
+		TArray<FString> Names;
+		TMap<uint64, uint32> BoundaryIds;
+	};
+
+	// record the c++ frame while the profiler runs, a due sample is taken at
+	// the exit so the native time is attributed to the boundary.
+	// as TraceScope, it must not enclose the code that can raise a lua error.
+	struct ProfilerScope
+	{
+		inline ProfilerScope(lua_State* State, EProfilerBoundary Kind, const void* Target)
+			: bActive(Profiler::IsRunning())
+		{
+			if (bActive) {
+				Profiler::Get().PushBoundary(State, Kind, Target);
+			}
+		}
+
+		inline ~ProfilerScope()
+		{
+			if (bActive) {
+				Profiler::Get().PopBoundary();
+			}
+		}
+
+		bool bActive;
+	};
+
+	// lua profile [start <hz> <count> | stop | reset | dump <path>]
+	TLua_API void ExecProfilerCommand(lua_State* State, const TCHAR* Cmd, FOutputDevice& Ar);
+}
@@ -3,9 +3,43 @@
 
 #include "TLuaCppLua.hpp"
 #include "TLuaRootObject.h"
+#include "TLuaProfiler.hpp"
+#include "TLuaTrace.hpp"
 
 namespace TLua
 {
+	// _protected_from_lua(processor, container, value)
+	static int CppProtectedFromLua(lua_State* State)
+	{
+		PropertyProcessor* Processor = (PropertyProcessor*)lua_touserdata(State, 1);
+		Processor->FromLua(State, 3, lua_touserdata(State, 2));
+		return 0;
+	}
+
+	void PropertyProcessor::FromLuaTraced(lua_State* State, int Index, void* Container)
+	{
+		if (!IsTraceEnabled() && !Profiler::IsRunning()) {
+			FromLua(State, Index, Container);
+			return;
+		}
+
+		Index = lua_absindex(State, Index);
+		lua_pushcfunction(State, CppProtectedFromLua);
+		lua_pushlightuserdata(State, this);
+		lua_pushlightuserdata(State, Container);
+		lua_pushvalue(State, Index);
+
+		int Result;
+		{
+			TLUA_TRACE_SCOPE(Property, true);
+			ProfilerScope Scope(State, EProfilerBoundary::SetProperty, this);
+			Result = lua_pcall(State, 3, 0, 0);
+		}
+		if (Result != LUA_OK) {
+			lua_error(State);
+		}
+	}
+
 	ProcessorVisitor::ProcessorVisitor() : Result(nullptr)
 	{
 
@@ -38,6 +72,16 @@ namespace TLua
 		Result = new Processor<FArrayProperty, void>(Property);
 	}
 
+	void ProcessorVisitor::Visit(FMapProperty* Property)
+	{
+		Result = new Processor<FMapProperty, void>(Property);
+	}
+
+	void ProcessorVisitor::Visit(FSetProperty* Property)
+	{
+		Result = new Processor<FSetProperty, void>(Property);
+	}
+
 	void ProcessorVisitor::Visit(FDelegateProperty* Property)
 	{
 		Result = new TDelegateProcessor<FDelegateProperty>(Property);
@@ -63,7 +107,10 @@ namespace TLua
 			void* Parameters = (void*)FMemory_Alloca(Property->SignatureFunction->ParmsSize);
 			Function.FillParameters(Parameters, State, ArgStartIndex);
 
-			Delegate->ProcessDelegate<UObject>(Parameters);
+			{
+				TLUA_TRACE_SCOPE(Property->SignatureFunction);
+				Delegate->ProcessDelegate<UObject>(Parameters);
+			}
 
 			return Function.FreeParameter(Parameters, State, ArgStartIndex);
 		}
@@ -77,6 +124,11 @@ namespace TLua
 			Delegate->BindUFunction(Object, TEXT("Callback"));
 		}
 
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) - sizeof(Function) + Function.GetAllocatedSize();
+		}
+
 	private:
 		FunctionContext Function;
 		FDelegateProperty* Property;
@@ -97,7 +149,10 @@ namespace TLua
 			void* Parameters = (void*)FMemory_Alloca(Property->SignatureFunction->ParmsSize);
 			Function.FillParameters(Parameters, State, ArgStartIndex);
 
-			Delegate->ProcessMulticastDelegate<UObject>(Parameters);
+			{
+				TLUA_TRACE_SCOPE(Property->SignatureFunction);
+				Delegate->ProcessMulticastDelegate<UObject>(Parameters);
+			}
 
 			return Function.FreeParameter(Parameters, State, ArgStartIndex);
 		}
@@ -114,6 +169,11 @@ namespace TLua
 			Delegate->Add(InDelegate);
 		}
 
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) - sizeof(Function) + Function.GetAllocatedSize();
+		}
+
 	private:
 		FunctionContext Function;
 		FMulticastDelegateProperty* Property;
@@ -5,6 +5,7 @@
 #include "UObject/UObjectGlobals.h"
 
 #include "TLua.h"
+#include "TLuaContainerView.hpp"
 #include "TLuaPropertyInfo.hpp"
 #include "TLuaTypeInfo.hpp"
 #include "TLuaTypes.hpp"
@@ -12,10 +13,194 @@
 
 namespace TLua
 {
+	inline void ScalarFromLua(const PropertyDesc& Desc, lua_State* State, int Index, void* Container)
+	{
+		uint8* ValuePtr = (uint8*)Container + Desc.Offset;
+
+		switch (Desc.Kind) {
+		case EPropertyKind::Bool:
+			*ValuePtr = (*ValuePtr & ~Desc.FieldMask) | (lua_toboolean(State, Index) ? Desc.ByteMask : 0);
+			break;
+		case EPropertyKind::Int8:
+			*(int8*)ValuePtr = (int8)lua_tointeger(State, Index);
+			break;
+		case EPropertyKind::Int16:
+			*(int16*)ValuePtr = (int16)lua_tointeger(State, Index);
+			break;
+		case EPropertyKind::Int32:
+			*(int32*)ValuePtr = (int32)lua_tointeger(State, Index);
+			break;
+		case EPropertyKind::Int64:
+			*(int64*)ValuePtr = (int64)lua_tointeger(State, Index);
+			break;
+		case EPropertyKind::UInt8:
+			*(uint8*)ValuePtr = (uint8)lua_tointeger(State, Index);
+			break;
+		case EPropertyKind::UInt16:
+			*(uint16*)ValuePtr = (uint16)lua_tointeger(State, Index);
+			break;
+		case EPropertyKind::UInt32:
+			*(uint32*)ValuePtr = (uint32)lua_tointeger(State, Index);
+			break;
+		case EPropertyKind::UInt64:
+			*(uint64*)ValuePtr = (uint64)lua_tointeger(State, Index);
+			break;
+		case EPropertyKind::Float:
+			*(float*)ValuePtr = (float)lua_tonumber(State, Index);
+			break;
+		case EPropertyKind::Double:
+			*(double*)ValuePtr = (double)lua_tonumber(State, Index);
+			break;
+		default:
+			break;
+		}
+	}
+
+	inline void ScalarToLua(const PropertyDesc& Desc, lua_State* State, const void* Container)
+	{
+		const uint8* ValuePtr = (const uint8*)Container + Desc.Offset;
+
+		switch (Desc.Kind) {
+		case EPropertyKind::Bool:
+			lua_pushboolean(State, (*ValuePtr & Desc.FieldMask) != 0);
+			break;
+		case EPropertyKind::Int8:
+			lua_pushinteger(State, *(const int8*)ValuePtr);
+			break;
+		case EPropertyKind::Int16:
+			lua_pushinteger(State, *(const int16*)ValuePtr);
+			break;
+		case EPropertyKind::Int32:
+			lua_pushinteger(State, *(const int32*)ValuePtr);
+			break;
+		case EPropertyKind::Int64:
+			lua_pushinteger(State, *(const int64*)ValuePtr);
+			break;
+		case EPropertyKind::UInt8:
+			lua_pushinteger(State, *(const uint8*)ValuePtr);
+			break;
+		case EPropertyKind::UInt16:
+			lua_pushinteger(State, *(const uint16*)ValuePtr);
+			break;
+		case EPropertyKind::UInt32:
+			lua_pushinteger(State, *(const uint32*)ValuePtr);
+			break;
+		case EPropertyKind::UInt64:
+			lua_pushinteger(State, (lua_Integer)*(const uint64*)ValuePtr);
+			break;
+		case EPropertyKind::Float:
+			lua_pushnumber(State, *(const float*)ValuePtr);
+			break;
+		case EPropertyKind::Double:
+			lua_pushnumber(State, *(const double*)ValuePtr);
+			break;
+		default:
+			lua_pushnil(State);
+			break;
+		}
+	}
+
+	template <typename Type>
+	inline void IntegerArrayToLua(lua_State* State, const void* Data, int Num)
+	{
+		const Type* Values = (const Type*)Data;
+		for (int Index = 0; Index < Num; ++Index) {
+			lua_pushinteger(State, (lua_Integer)Values[Index]);
+			lua_rawseti(State, -2, Index + 1);
+		}
+	}
+
+	template <typename Type>
+	inline void NumberArrayToLua(lua_State* State, const void* Data, int Num)
+	{
+		const Type* Values = (const Type*)Data;
+		for (int Index = 0; Index < Num; ++Index) {
+			lua_pushnumber(State, (lua_Number)Values[Index]);
+			lua_rawseti(State, -2, Index + 1);
+		}
+	}
+
+	template <typename Type>
+	inline void IntegerArrayFromLua(lua_State* State, int Index, void* Data, int Num)
+	{
+		Type* Values = (Type*)Data;
+		for (int Item = 0; Item < Num; ++Item) {
+			lua_rawgeti(State, Index, Item + 1);
+			Values[Item] = (Type)lua_tointeger(State, -1);
+			lua_pop(State, 1);
+		}
+	}
+
+	template <typename Type>
+	inline void NumberArrayFromLua(lua_State* State, int Index, void* Data, int Num)
+	{
+		Type* Values = (Type*)Data;
+		for (int Item = 0; Item < Num; ++Item) {
+			lua_rawgeti(State, Index, Item + 1);
+			Values[Item] = (Type)lua_tonumber(State, -1);
+			lua_pop(State, 1);
+		}
+	}
+
+	// stack: ..., table
+	// the packed scalar elements, return false if it's not a scalar kind
+	inline bool ScalarArrayToLua(const PropertyDesc& Desc, lua_State* State, const void* Data, int Num)
+	{
+		switch (Desc.Kind) {
+		case EPropertyKind::Bool:
+			for (int Index = 0; Index < Num; ++Index) {
+				const uint8* ValuePtr = (const uint8*)Data + Index * Desc.ElementSize + Desc.Offset;
+				lua_pushboolean(State, (*ValuePtr & Desc.FieldMask) != 0);
+				lua_rawseti(State, -2, Index + 1);
+			}
+			return true;
+		case EPropertyKind::Int8: IntegerArrayToLua<int8>(State, Data, Num); return true;
+		case EPropertyKind::Int16: IntegerArrayToLua<int16>(State, Data, Num); return true;
+		case EPropertyKind::Int32: IntegerArrayToLua<int32>(State, Data, Num); return true;
+		case EPropertyKind::Int64: IntegerArrayToLua<int64>(State, Data, Num); return true;
+		case EPropertyKind::UInt8: IntegerArrayToLua<uint8>(State, Data, Num); return true;
+		case EPropertyKind::UInt16: IntegerArrayToLua<uint16>(State, Data, Num); return true;
+		case EPropertyKind::UInt32: IntegerArrayToLua<uint32>(State, Data, Num); return true;
+		case EPropertyKind::UInt64: IntegerArrayToLua<uint64>(State, Data, Num); return true;
+		case EPropertyKind::Float: NumberArrayToLua<float>(State, Data, Num); return true;
+		case EPropertyKind::Double: NumberArrayToLua<double>(State, Data, Num); return true;
+		default:
+			return false;
+		}
+	}
+
+	// Index: absolute index of the table, Data: memory of Num elements
+	inline bool ScalarArrayFromLua(const PropertyDesc& Desc, lua_State* State, int Index, void* Data, int Num)
+	{
+		switch (Desc.Kind) {
+		case EPropertyKind::Bool:
+			for (int Item = 0; Item < Num; ++Item) {
+				uint8* ValuePtr = (uint8*)Data + Item * Desc.ElementSize + Desc.Offset;
+				lua_rawgeti(State, Index, Item + 1);
+				*ValuePtr = (*ValuePtr & ~Desc.FieldMask) | (lua_toboolean(State, -1) ? Desc.ByteMask : 0);
+				lua_pop(State, 1);
+			}
+			return true;
+		case EPropertyKind::Int8: IntegerArrayFromLua<int8>(State, Index, Data, Num); return true;
+		case EPropertyKind::Int16: IntegerArrayFromLua<int16>(State, Index, Data, Num); return true;
+		case EPropertyKind::Int32: IntegerArrayFromLua<int32>(State, Index, Data, Num); return true;
+		case EPropertyKind::Int64: IntegerArrayFromLua<int64>(State, Index, Data, Num); return true;
+		case EPropertyKind::UInt8: IntegerArrayFromLua<uint8>(State, Index, Data, Num); return true;
+		case EPropertyKind::UInt16: IntegerArrayFromLua<uint16>(State, Index, Data, Num); return true;
+		case EPropertyKind::UInt32: IntegerArrayFromLua<uint32>(State, Index, Data, Num); return true;
+		case EPropertyKind::UInt64: IntegerArrayFromLua<uint64>(State, Index, Data, Num); return true;
+		case EPropertyKind::Float: NumberArrayFromLua<float>(State, Index, Data, Num); return true;
+		case EPropertyKind::Double: NumberArrayFromLua<double>(State, Index, Data, Num); return true;
+		default:
+			return false;
+		}
+	}
+
 	class PropertyProcessor
 	{
 	public:
-		inline PropertyProcessor(FProperty* InProperty) : Property(InProperty)
+		inline PropertyProcessor(FProperty* InProperty)
+			: Property(InProperty), Desc(MakePropertyDesc(InProperty))
 		{
 			FString OriginName = Property->GetName();
 			AnsiName = std::string(TCHAR_TO_ANSI(*OriginName));
@@ -23,8 +208,41 @@ namespace TLua
 
 		virtual ~PropertyProcessor() {}
 
-		virtual void FromLua(lua_State* State, int Index, void* OutValue) = 0;
-		virtual void ToLua(lua_State* State, const void* Value) = 0;
+		// the scalar property is processed inline by the descriptor,
+		// only the complex one goes through the virtual call.
+		inline void FromLua(lua_State* State, int Index, void* Container)
+		{
+			if (Desc.Kind == EPropertyKind::Complex) {
+				FromLuaImp(State, Index, Container);
+				return;
+			}
+
+			ScalarFromLua(Desc, State, Index, Container);
+		}
+
+		// FromLua for the property set from lua, within the trace and profiler scopes.
+		// the conversion runs in a protected call while they record, the scopes end
+		// before the error is raised again
+		void FromLuaTraced(lua_State* State, int Index, void* Container);
+
+		inline void ToLua(lua_State* State, const void* Container)
+		{
+			if (Desc.Kind == EPropertyKind::Complex) {
+				ToLuaImp(State, Container);
+				return;
+			}
+
+			ScalarToLua(Desc, State, Container);
+		}
+
+		inline bool IsScalar() const
+		{
+			return Desc.Kind != EPropertyKind::Complex;
+		}
+
+		virtual void FromLuaImp(lua_State* State, int Index, void* Container) = 0;
+		virtual void ToLuaImp(lua_State* State, const void* Container) = 0;
+
 		inline virtual void ReturnToLua(lua_State* State, const void* Value)
 		{
 			ToLua(State, Value);
@@ -35,6 +253,12 @@ namespace TLua
 			DestroyValue_InContainer(Container);
 		}
 
+		// memory held by the processor, include the inner processors
+		inline virtual SIZE_T GetAllocatedSize() const
+		{
+			return sizeof(PropertyProcessor) + AnsiName.capacity();
+		}
+
 	public:
 		inline const char* GetAnsiName()
 		{
@@ -48,6 +272,7 @@ namespace TLua
 
 	public:
 		FProperty* Property;
+		PropertyDesc Desc;
 		std::string AnsiName;
 	};
 
@@ -61,6 +286,7 @@ namespace TLua
 		virtual ~DelegateAccessor() {}
 		virtual int Execute(void* Self, lua_State* State, int ArgStartIndex) = 0;
 		virtual void Bind(void* Self, lua_State* State, int Index) = 0;
+		virtual SIZE_T GetAllocatedSize() const = 0;
 	private:
 	};
 
@@ -77,18 +303,23 @@ namespace TLua
 		{
 		}
 
-		virtual void FromLua(lua_State* State, int Index, void* Container) override
+		virtual void FromLuaImp(lua_State* State, int Index, void* Container) override
 		{
 			Property->SetPropertyValue_InContainer(Container, 
 						TypeInfo<ValueType>::FromLua(State, Index));
 		}
 
-		virtual void ToLua(lua_State* State, const void* Container) override
+		virtual void ToLuaImp(lua_State* State, const void* Container) override
 		{
 			const ValueType* ValuePtr = Property->ContainerPtrToValuePtr<ValueType>(Container);
 			TypeInfo<ValueType>::ToLua(State, *ValuePtr);
 		}
 
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) + AnsiName.capacity();
+		}
+
 	private:
 		PropertyType* Property;
 	};
@@ -101,69 +332,84 @@ namespace TLua
 		virtual ~Processor() {}
 
 		Processor(FStructProperty* InProperty) 
-			: PropertyProcessor(InProperty), Property(InProperty)
+			: PropertyProcessor(InProperty), Property(InProperty),
+			bValueType(IsValueStruct(InProperty->Struct)),
+			bTrivial(InProperty->HasAnyPropertyFlags(CPF_NoDestructor | CPF_IsPlainOldData))
 		{
 		}
 
-		virtual void FromLua(lua_State* State, int Index, void* Container) override
+		virtual void FromLuaImp(lua_State* State, int Index, void* Container) override
 		{
-			if (!LuaIsTable(State, Index)) {
-				return;
+			void* Source = GetLuaValue(State, Index);
+			if (Source) {
+				Property->SetValue_InContainer(Container, Source);
 			}
-
-			LuaGetField(State, Index, "_co");
-			void* Source = (void*)LuaGetUserData(State, -1);
-			LuaPop(State, 1);
-
-			Property->SetValue_InContainer(Container, Source);
 		}
 
-		virtual void ToLua(lua_State* State, const void* Container) override
+		virtual void ToLuaImp(lua_State* State, const void* Container) override
 		{
 			const void* Value = Property->ContainerPtrToValuePtr<void>(Container);
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
-			LuaGetGlobal(State, "_lua_get_struct");
-			LuaPushUserData(State, (void*)Value);
-			LuaPushUserData(State, (void*)Property->Struct);
-			LuaPCall(State, 3, 1);
+			if (bValueType) {
+				Property->CopyCompleteValue(NewValue(State, Property->Struct), Value);
+				return;
+			}
+
+			// reference to the memory of the container
+			PushStructRef(State, Property->Struct, (void*)Value);
 		}
 
 		virtual void ReturnToLua(lua_State* State, const void* Container) override
 		{
 			const void* Source = Property->ContainerPtrToValuePtr<void>(Container);
-			void* Value = LuaNewUserData(State, Property->Struct->GetStructureSize(), 0);
-			Property->CopyCompleteValue(Value, Source); 
+			if (bValueType) {
+				Property->CopyCompleteValue(NewValue(State, Property->Struct), Source);
+				return;
+			}
 
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
-			LuaGetGlobal(State, "_lua_get_struct");
-			LuaPushUserData(State, (void*)Value);
-			LuaPushUserData(State, (void*)Property->Struct);
-			LuaPushUserData(State, (void*)Property);
-			LuaPCall(State, 4, 1);
+			PushStructCopy(State, Property->Struct, Source);
 		}
 
 		virtual void DestroyValue(void* Container, lua_State* State, int Index) override
 		{
-			if (!LuaIsTable(State, Index)) {
+			if (Property->HasAnyPropertyFlags(CPF_ReferenceParm)) {
+				// copy back the reference
+				void* LuaValue = GetLuaValue(State, Index);
+				if (LuaValue) {
+					Property->CopyCompleteValue(LuaValue, Property->ContainerPtrToValuePtr<void>(Container));
+				}
+			}
+
+			if (!bTrivial) {
 				Property->DestroyValue_InContainer(Container);
-				return;
 			}
+		}
 
-			if (Property->HasAnyPropertyFlags(CPF_ReferenceParm)) {
-				// copy back the reference
-				LuaGetField(State, Index, "_co");
-				void* LuaValue = (void*)LuaGetUserData(State, -1);
-				LuaPop(State, 1);
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) + AnsiName.capacity();
+		}
 
-				void* CppValue = Property->ContainerPtrToValuePtr<void*>(Container);
-				Property->CopyCompleteValue(LuaValue, CppValue);
+	private:
+		// the value type, the struct proxy, or the lua side struct {_co = ...}
+		void* GetLuaValue(lua_State* State, int Index)
+		{
+			void* Value = bValueType ? ToValue(State, Index, Property->Struct)
+				: GetStructValue(State, Index, Property->Struct);
+			if (Value || !LuaIsTable(State, Index)) {
+				return Value;
 			}
-			
-			Property->DestroyValue_InContainer(Container);
+
+			LuaGetField(State, Index, "_co");
+			Value = (void*)LuaGetUserData(State, -1);
+			LuaPop(State, 1);
+			return Value;
 		}
 
 	private:
 		FStructProperty* Property;
+		// pushed by value, see TLuaValueTypes.hpp
+		bool bValueType;
+		bool bTrivial;
 	};
 
 	template <>
@@ -171,7 +417,10 @@ namespace TLua
 		: public PropertyProcessor
 	{
 	public:
-		virtual ~Processor() {}
+		virtual ~Processor()
+		{
+			delete UnderlyingProcessor;
+		}
 
 		Processor(FEnumProperty* InProperty) 
 			: PropertyProcessor(InProperty), Property(InProperty)
@@ -179,16 +428,21 @@ namespace TLua
 			UnderlyingProcessor = CreatePropertyProcessor(Property->GetUnderlyingProperty());
 		}
 
-		virtual void FromLua(lua_State* State, int Index, void* Container) override
+		virtual void FromLuaImp(lua_State* State, int Index, void* Container) override
 		{
 			UnderlyingProcessor->FromLua(State, Index, Container);
 		}
 
-		virtual void ToLua(lua_State* State, const void* Container) override
+		virtual void ToLuaImp(lua_State* State, const void* Container) override
 		{
 			UnderlyingProcessor->ToLua(State, Container);
 		}
 
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) + AnsiName.capacity() + UnderlyingProcessor->GetAllocatedSize();
+		}
+
 	private:
 		PropertyProcessor* UnderlyingProcessor;
 		FEnumProperty* Property;
@@ -198,63 +452,325 @@ namespace TLua
 	class Processor<FArrayProperty, void> : public PropertyProcessor
 	{
 	public:
-		virtual ~Processor() {}
+		virtual ~Processor()
+		{
+			delete InnerProcessor;
+		}
 
 		Processor(FArrayProperty* InProperty) 
 			: PropertyProcessor(InProperty), Property(InProperty)
 		{
 			InnerProcessor = CreatePropertyProcessor(Property->Inner);
+			bNameInner = CastField<FNameProperty>(Property->Inner) != nullptr;
 		}
 
-		virtual void FromLua(lua_State* State, int Index, void* Container) override
+		virtual void FromLuaImp(lua_State* State, int Index, void* Container) override
 		{
+			void* ArrayPtr = Property->ContainerPtrToValuePtr<void>(Container);
+
+			// assign from the view of the other array
+			if (ContainerView* View = ToContainerView(State, Index, Property)) {
+				if (View->Container != ArrayPtr) {
+					Property->CopyCompleteValue(ArrayPtr, View->Container);
+				}
+				return;
+			}
+
 			if (!LuaIsTable(State, Index)) {
 				return;
 			}
+			Index = lua_absindex(State, Index);
 
-			void* ArrayPtr = Property->ContainerPtrToValuePtr<void>(Container);
 			FScriptArrayHelper Array(Property, ArrayPtr);
-			if (Array.Num() != 0) {
-				Array.RemoveValues(0, Array.Num());
+
+			// resize in one step, the scalar elements are all overwritten
+			int Size = (int)lua_rawlen(State, Index);
+			if (InnerProcessor->IsScalar()) {
+				Array.EmptyAndAddUninitializedValues(Size);
+				if (Size > 0) {
+					ScalarArrayFromLua(InnerProcessor->Desc, State, Index, Array.GetRawPtr(0), Size);
+				}
+				return;
 			}
 
-			int Size = LuaGetTableSize(State, Index);
-			for (int ArrayIndex = 0; ArrayIndex < Size; ++ArrayIndex) {
-				int ItemIndex = Array.AddValue();
-				void* ItemPtr = Array.GetRawPtr(ItemIndex);
+			Array.EmptyAndAddValues(Size);
+			if (Size == 0) {
+				return;
+			}
 
-				LuaGetI(State, Index, ArrayIndex + 1);
-				InnerProcessor->FromLua(State, -1, ItemPtr);
-				LuaPop(State);
+			if (bNameInner) {
+				FName* Names = (FName*)Array.GetRawPtr(0);
+				for (int ArrayIndex = 0; ArrayIndex < Size; ++ArrayIndex) {
+					lua_rawgeti(State, Index, ArrayIndex + 1);
+					Names[ArrayIndex] = TypeInfo<FName>::FromLua(State, -1);
+					lua_pop(State, 1);
+				}
+				return;
 			}
+
+			for (int ArrayIndex = 0; ArrayIndex < Size; ++ArrayIndex) {
+				lua_rawgeti(State, Index, ArrayIndex + 1);
+				InnerProcessor->FromLua(State, -1, Array.GetRawPtr(ArrayIndex));
+				lua_pop(State, 1);
+			}
+		}
+
+		// the view of the array, the elements are read on access
+		virtual void ToLuaImp(lua_State* State, const void* Container) override
+		{
+			void* ArrayPtr = Property->ContainerPtrToValuePtr<void>((void*)Container);
+			PushArrayView(State, Property, InnerProcessor, ArrayPtr);
 		}
 
-		virtual void ToLua(lua_State* State, const void* Container) override
+		// the memory of the return value dies after the call, copy to the table
+		virtual void ReturnToLua(lua_State* State, const void* Container) override
 		{
 			const void* ArrayPtr = Property->ContainerPtrToValuePtr<void>(Container);
 			FScriptArrayHelper Array(Property, ArrayPtr);
 
-			LuaNewTable(State);
-			for (int Index = 0; Index < Array.Num(); ++Index) {
-				void* ItemPtr = Array.GetRawPtr(Index);
-				LuaPushInteger(State, Index + 1);
-				InnerProcessor->ToLua(State, ItemPtr);
-				LuaSetTable(State, -3);
+			int Num = Array.Num();
+			lua_createtable(State, Num, 0);
+			if (Num == 0) {
+				return;
+			}
+
+			if (ScalarArrayToLua(InnerProcessor->Desc, State, Array.GetRawPtr(0), Num)) {
+				return;
 			}
+
+			if (bNameInner) {
+				const FName* Names = (const FName*)Array.GetRawPtr(0);
+				for (int Index = 0; Index < Num; ++Index) {
+					TypeInfo<FName>::ToLua(State, Names[Index]);
+					lua_rawseti(State, -2, Index + 1);
+				}
+				return;
+			}
+
+			for (int Index = 0; Index < Num; ++Index) {
+				InnerProcessor->ReturnToLua(State, Array.GetRawPtr(Index));
+				lua_rawseti(State, -2, Index + 1);
+			}
+		}
+
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) + AnsiName.capacity() + InnerProcessor->GetAllocatedSize();
 		}
 
 	private:
 		FArrayProperty* Property;
 		PropertyProcessor* InnerProcessor;
+		bool bNameInner;
+	};
+
+	template <>
+	class Processor<FMapProperty, void> : public PropertyProcessor
+	{
+	public:
+		virtual ~Processor()
+		{
+			delete KeyProcessor;
+			delete ValueProcessor;
+		}
+
+		Processor(FMapProperty* InProperty)
+			: PropertyProcessor(InProperty), Property(InProperty)
+		{
+			KeyProcessor = CreatePropertyProcessor(Property->KeyProp);
+			ValueProcessor = CreatePropertyProcessor(Property->ValueProp);
+		}
+
+		virtual void FromLuaImp(lua_State* State, int Index, void* Container) override
+		{
+			void* MapPtr = Property->ContainerPtrToValuePtr<void>(Container);
+
+			if (ContainerView* View = ToContainerView(State, Index, Property)) {
+				if (View->Container != MapPtr) {
+					Property->CopyCompleteValue(MapPtr, View->Container);
+				}
+				return;
+			}
+
+			if (!LuaIsTable(State, Index)) {
+				return;
+			}
+			Index = lua_absindex(State, Index);
+
+			FScriptMapHelper Map(Property, MapPtr);
+			Map.EmptyValues();
+
+			// the temporary pair, the key at 0 and the value at the offset of the layout.
+			// different lua keys may convert to the same key ("a" and "A" of FName), the last one wins
+			FProperty* KeyProp = Property->KeyProp;
+			FProperty* ValueProp = Property->ValueProp;
+			int32 ValueOffset = ValueProp->GetOffset_ForInternal();
+			uint8* Pair = (uint8*)FMemory_Alloca_Aligned(ValueOffset + ValueProp->GetSize(),
+				FMath::Max(KeyProp->GetMinAlignment(), ValueProp->GetMinAlignment()));
+
+			lua_pushnil(State);
+			while (lua_next(State, Index)) {						// key, value
+				KeyProp->InitializeValue(Pair);
+				ValueProp->InitializeValue(Pair + ValueOffset);
+
+				// convert a copy, lua_tolstring changes the number key and breaks lua_next
+				lua_pushvalue(State, -2);							// key, value, key
+				KeyProcessor->FromLua(State, -1, Pair);
+				ValueProcessor->FromLua(State, -2, Pair);
+				Map.AddPair(Pair, Pair + ValueOffset);
+
+				KeyProp->DestroyValue(Pair);
+				ValueProp->DestroyValue(Pair + ValueOffset);
+				lua_pop(State, 2);									// key
+			}
+		}
+
+		// the view of the map, the pairs are read on access
+		virtual void ToLuaImp(lua_State* State, const void* Container) override
+		{
+			void* MapPtr = Property->ContainerPtrToValuePtr<void>((void*)Container);
+			PushMapView(State, Property, KeyProcessor, ValueProcessor, MapPtr);
+		}
+
+		virtual void ReturnToLua(lua_State* State, const void* Container) override
+		{
+			const void* MapPtr = Property->ContainerPtrToValuePtr<void>(Container);
+			FScriptMapHelper Map(Property, MapPtr);
+
+			lua_createtable(State, 0, Map.Num());
+			for (int32 Index = 0, MaxIndex = Map.GetMaxIndex(); Index < MaxIndex; ++Index) {
+				if (!Map.IsValidIndex(Index)) {
+					continue;
+				}
+				const uint8* Pair = Map.GetPairPtr(Index);
+				KeyProcessor->ReturnToLua(State, Pair);
+				ValueProcessor->ReturnToLua(State, Pair);
+				lua_rawset(State, -3);
+			}
+		}
+
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) + AnsiName.capacity()
+				+ KeyProcessor->GetAllocatedSize() + ValueProcessor->GetAllocatedSize();
+		}
+
+	private:
+		FMapProperty* Property;
+		PropertyProcessor* KeyProcessor;
+		PropertyProcessor* ValueProcessor;
+	};
+
+	template <>
+	class Processor<FSetProperty, void> : public PropertyProcessor
+	{
+	public:
+		virtual ~Processor()
+		{
+			delete ElementProcessor;
+		}
+
+		Processor(FSetProperty* InProperty)
+			: PropertyProcessor(InProperty), Property(InProperty)
+		{
+			ElementProcessor = CreatePropertyProcessor(Property->ElementProp);
+		}
+
+		// the table is a list of the elements, or the keys of {element = true}
+		virtual void FromLuaImp(lua_State* State, int Index, void* Container) override
+		{
+			void* SetPtr = Property->ContainerPtrToValuePtr<void>(Container);
+
+			if (ContainerView* View = ToContainerView(State, Index, Property)) {
+				if (View->Container != SetPtr) {
+					Property->CopyCompleteValue(SetPtr, View->Container);
+				}
+				return;
+			}
+
+			if (!LuaIsTable(State, Index)) {
+				return;
+			}
+			Index = lua_absindex(State, Index);
+
+			FScriptSetHelper Set(Property, SetPtr);
+			Set.EmptyElements();
+
+			// different lua values may convert to the same element, added once
+			FProperty* ElementProp = Property->ElementProp;
+			uint8* Element = (uint8*)FMemory_Alloca_Aligned(ElementProp->GetSize(), ElementProp->GetMinAlignment());
+
+			int Size = (int)lua_rawlen(State, Index);
+			if (Size > 0) {
+				for (int ArrayIndex = 1; ArrayIndex <= Size; ++ArrayIndex) {
+					lua_rawgeti(State, Index, ArrayIndex);
+					ElementProp->InitializeValue(Element);
+					ElementProcessor->FromLua(State, -1, Element);
+					Set.AddElement(Element);
+					ElementProp->DestroyValue(Element);
+					lua_pop(State, 1);
+				}
+			}
+			else {
+				lua_pushnil(State);
+				while (lua_next(State, Index)) {					// element, flag
+					if (lua_toboolean(State, -1)) {
+						// convert a copy, lua_tolstring changes the number key and breaks lua_next
+						lua_pushvalue(State, -2);					// element, flag, element
+						ElementProp->InitializeValue(Element);
+						ElementProcessor->FromLua(State, -1, Element);
+						Set.AddElement(Element);
+						ElementProp->DestroyValue(Element);
+						lua_pop(State, 1);
+					}
+					lua_pop(State, 1);
+				}
+			}
+		}
+
+		// the view of the set, the elements are read on access
+		virtual void ToLuaImp(lua_State* State, const void* Container) override
+		{
+			void* SetPtr = Property->ContainerPtrToValuePtr<void>((void*)Container);
+			PushSetView(State, Property, ElementProcessor, SetPtr);
+		}
+
+		virtual void ReturnToLua(lua_State* State, const void* Container) override
+		{
+			const void* SetPtr = Property->ContainerPtrToValuePtr<void>(Container);
+			FScriptSetHelper Set(Property, SetPtr);
+
+			lua_createtable(State, 0, Set.Num());
+			for (int32 Index = 0, MaxIndex = Set.GetMaxIndex(); Index < MaxIndex; ++Index) {
+				if (!Set.IsValidIndex(Index)) {
+					continue;
+				}
+				ElementProcessor->ReturnToLua(State, Set.GetElementPtr(Index));
+				lua_pushboolean(State, 1);
+				lua_rawset(State, -3);
+			}
+		}
+
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) + AnsiName.capacity() + ElementProcessor->GetAllocatedSize();
+		}
+
+	private:
+		FSetProperty* Property;
+		PropertyProcessor* ElementProcessor;
 	};
 
 	template <typename DelegateType>
 	class TDelegateProcessor : public PropertyProcessor
 	{
 	public:
-		virtual ~TDelegateProcessor() {}
+		virtual ~TDelegateProcessor()
+		{
+			delete InnerAccessor;
+		}
 
-		virtual void FromLua(lua_State* State, int Index, void* Container) override
+		virtual void FromLuaImp(lua_State* State, int Index, void* Container) override
 		{
 
 		}
@@ -265,14 +781,19 @@ namespace TLua
 			InnerAccessor = CreateDelegateAccessor(Property);
 		}
 
-		virtual void ToLua(lua_State* State, const void* Container)
+		virtual void ToLuaImp(lua_State* State, const void* Container) override
 		{
 			auto* DelegatePtr = Property->ContainerPtrToValuePtr<void>(Container);
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
+			int Handler = LuaPushTraceHandler(State);
 			LuaGetGlobal(State, "_lua_get_delegate");
 			LuaPushUserData(State, (void*)DelegatePtr);
 			LuaPushUserData(State, (void*)InnerAccessor);
-			LuaPCall(State, 3, 1);
+			LuaTraceCall(State, Handler, 2, 1);
+		}
+
+		virtual SIZE_T GetAllocatedSize() const override
+		{
+			return sizeof(*this) + AnsiName.capacity() + InnerAccessor->GetAllocatedSize();
 		}
 
 	private:
@@ -353,6 +874,12 @@ namespace TLua
 		else if (auto* ArrayProperty = CastField<FArrayProperty>(Property)) {
 			Dispatcher.Visit(ArrayProperty);
 		}
+		else if (auto* MapProperty = CastField<FMapProperty>(Property)) {
+			Dispatcher.Visit(MapProperty);
+		}
+		else if (auto* SetProperty = CastField<FSetProperty>(Property)) {
+			Dispatcher.Visit(SetProperty);
+		}
 		else if (auto* DelegateProperty = CastField<FDelegateProperty>(Property)) {
 			Dispatcher.Visit(DelegateProperty);
 		}
@@ -380,6 +907,8 @@ namespace TLua
 
 		void Visit(FObjectProperty* Property);
 		void Visit(FArrayProperty* Property);
+		void Visit(FMapProperty* Property);
+		void Visit(FSetProperty* Property);
 		void Visit(FDelegateProperty* Property);
 		void Visit(FMulticastDelegateProperty* Property);
 
@@ -6,6 +6,84 @@
 
 namespace TLua
 {
+	// scalar kinds are read and written through the PropertyDesc,
+	// the other properties are processed by the virtual processor.
+	enum class EPropertyKind : uint8
+	{
+		Complex,
+		Bool,
+		Int8,
+		Int16,
+		Int32,
+		Int64,
+		UInt8,
+		UInt16,
+		UInt32,
+		UInt64,
+		Float,
+		Double,
+	};
+
+	// compact POD descriptor of the property value in the container
+	struct PropertyDesc
+	{
+		int32 Offset;
+		EPropertyKind Kind;
+		uint8 ElementSize;
+		uint8 FieldMask;	// bool only
+		uint8 ByteMask;		// bool only
+	};
+
+	inline PropertyDesc MakePropertyDesc(FProperty* Property)
+	{
+		static const struct
+		{
+			uint64 CastFlag;
+			EPropertyKind Kind;
+		} ScalarKinds[] = {
+			{ CASTCLASS_FBoolProperty, EPropertyKind::Bool },
+			{ CASTCLASS_FInt8Property, EPropertyKind::Int8 },
+			{ CASTCLASS_FInt16Property, EPropertyKind::Int16 },
+			{ CASTCLASS_FIntProperty, EPropertyKind::Int32 },
+			{ CASTCLASS_FInt64Property, EPropertyKind::Int64 },
+			{ CASTCLASS_FByteProperty, EPropertyKind::UInt8 },
+			{ CASTCLASS_FUInt16Property, EPropertyKind::UInt16 },
+			{ CASTCLASS_FUInt32Property, EPropertyKind::UInt32 },
+			{ CASTCLASS_FUInt64Property, EPropertyKind::UInt64 },
+			{ CASTCLASS_FFloatProperty, EPropertyKind::Float },
+			{ CASTCLASS_FDoubleProperty, EPropertyKind::Double },
+		};
+
+		PropertyDesc Desc;
+		Desc.Offset = Property->GetOffset_ForInternal();
+		Desc.Kind = EPropertyKind::Complex;
+		Desc.ElementSize = (uint8)FMath::Min(Property->ElementSize, 255);
+		Desc.FieldMask = 0xFF;
+		Desc.ByteMask = 0xFF;
+
+		// enum is stored as the underlying integer
+		FProperty* ValueProperty = Property;
+		if (FEnumProperty* EnumProperty = CastField<FEnumProperty>(Property)) {
+			ValueProperty = EnumProperty->GetUnderlyingProperty();
+		}
+
+		uint64 CastFlags = ValueProperty->GetCastFlags();
+		for (const auto& Scalar : ScalarKinds) {
+			if (CastFlags & Scalar.CastFlag) {
+				Desc.Kind = Scalar.Kind;
+				break;
+			}
+		}
+
+		if (FBoolProperty* BoolProperty = CastField<FBoolProperty>(Property)) {
+			Desc.Offset += BoolProperty->GetByteOffset();
+			Desc.FieldMask = BoolProperty->GetFieldMask();
+			Desc.ByteMask = BoolProperty->GetByteMask();
+		}
+
+		return Desc;
+	}
+
 	template <typename Property>
 	struct PropertyInfo {};
 
@@ -5,8 +5,10 @@
 
 #include "TLua.h"
 #include "TLua.hpp"
+#include "TLuaGC.hpp"
+#include "TLuaMemory.hpp"
 
-FRootTickFunction::FRootTickFunction() : Owner(nullptr)
+FRootTickFunction::FRootTickFunction() : Owner(nullptr), bEndOfFrame(false)
 {
 	this->bCanEverTick = true;
 	this->bStartWithTickEnabled = true;
@@ -20,103 +22,423 @@ void FRootTickFunction::ExecuteTick(
 	ENamedThreads::Type CurrentThread,
 	const FGraphEventRef& MyCompletionGraphEvent)
 {
-	Owner->Tick(DeltaTime);
+	if (bEndOfFrame) {
+		Owner->EndTick(DeltaTime);
+	}
+	else {
+		Owner->Tick(DeltaTime);
+	}
 }
 
 FString FRootTickFunction::DiagnosticMessage()
 {
-	return TEXT("RootObject::Tick");
-}
-
-FCallbackMgr::Callback::~Callback()
-{
-	if (Key) {
-		lua_State* State = TLua::GetLuaState();
-		lua_pushlightuserdata(State, this);
-		lua_pushnil(State);
-		lua_settable(State, LUA_REGISTRYINDEX);
-	}
-	Key = nullptr;
+	return bEndOfFrame ? TEXT("RootObject::EndTick") : TEXT("RootObject::Tick");
 }
 
-// stack: ... fun_to_bind
-void FCallbackMgr::Callback::Bind()
+void FCallbackMgr::Callback::Call() const
 {
-	Key = this;
-
 	lua_State* State = TLua::GetLuaState();
-	lua_pushlightuserdata(State, this);
-	lua_pushvalue(State, -2);
-	lua_settable(State, LUA_REGISTRYINDEX);
+	int Handler = TLua::LuaPushTraceHandler(State);
+	lua_rawgeti(State, LUA_REGISTRYINDEX, FunctionRef);
+	TLua::LuaTraceCall(State, Handler, 0);
 }
 
-void FCallbackMgr::Callback::Call()
+// callback manager
+FCallbackMgr::FCallbackMgr(int InNextId) : NextId(InNextId), Sequence(0), CurrentTime(0.), Frame(0)
 {
-	lua_State* State = TLua::GetLuaState();
-	lua_getglobal(State, TLUA_TRACE_CALL_NAME);
-	lua_pushlightuserdata(State, this);
-	lua_gettable(State, LUA_REGISTRYINDEX);
-	lua_pcall(State, 1, 0, 0); // ᷵ش, luaڲ.
 }
 
-// callback manager
-FCallbackMgr::FCallbackMgr(int InNextId) : NextId(InNextId), CurrentTime(0.)
+FCallbackMgr::~FCallbackMgr()
 {
+	Clear();
 }
 
 // _add_callback(..., delta, fun)
 int FCallbackMgr::AddCallback(lua_State* State)
+{
+	// duration
+	float Delta = lua_tonumber(State, -2);
+
+	return AddTimer(State, ClockTime, Delta, 0., 1, nullptr);
+}
+
+// stack: ..., fun
+int FCallbackMgr::AddTimer(lua_State* State, EClock Clock, double Delay, double Interval, int Count, const UObject* Owner)
 {
 	// alloc the id
 	int Id = NextId;
 	NextId += 1;
 
-	// duration
-	float Delta = lua_tonumber(State, -2);
-	double ActivateTime = std::nextafter(CurrentTime + Delta, std::numeric_limits<double>::infinity());
+	Callback Item;
+	if (Clock == ClockTime) {
+		Item.Time = std::nextafter(CurrentTime + Delay, std::numeric_limits<double>::infinity());
+	}
+	else {
+		Item.Time = (double)Frame + FMath::Max(FMath::FloorToDouble(Delay), 1.);
+	}
+	Item.Interval = Interval;
+	Item.Sequence = Sequence++;
+	Item.Owner = Owner;
+	Item.Id = Id;
+	lua_pushvalue(State, -1);
+	Item.FunctionRef = luaL_ref(State, LUA_REGISTRYINDEX);
+	Item.Remaining = FMath::Max(Count, 0);
+	Item.Clock = Clock;
 
-	auto Iterator = Callbacks.emplace(std::make_pair(ActivateTime, Callback()));
+	Push(Item);
 
-	Iterator->second.Id = Id;
-	Iterator->second.Bind();
-	
 	return Id;
 }
 
 void FCallbackMgr::Cancel(int Handle)
 {
-	for (CallbackMap::iterator It = Callbacks.begin(); It != Callbacks.end(); ++It) {
-		if (It->second.Id == Handle) {
-			Callbacks.erase(It);
-			return;
-		}
+	CallbackSlot* Slot = Slots.Find(Handle);
+	if (!Slot) {
+		return;
+	}
+
+	Release(RemoveAt(Slot->Clock, Slot->Index));
+}
+
+int FCallbackMgr::CancelOwner(const UObject* Owner)
+{
+	TArray<int> Ids;
+	Owners.MultiFind(Owner, Ids);
+
+	for (int Id : Ids) {
+		Cancel(Id);
 	}
+	return Ids.Num();
 }
 
 void FCallbackMgr::Clear()
 {
-	Callbacks.clear();
+	if (Slots.Num() > 0) {
+		lua_State* State = TLua::GetLuaState();
+		for (TArray<Callback>& Heap : Heaps) {
+			for (const Callback& Item : Heap) {
+				luaL_unref(State, LUA_REGISTRYINDEX, Item.FunctionRef);
+			}
+		}
+	}
+
+	for (TArray<Callback>& Heap : Heaps) {
+		Heap.Empty();
+	}
+	Slots.Empty();
+	Owners.Empty();
 }
 
 void FCallbackMgr::Tick(float Delta)
 {
 	CurrentTime += Delta;
+	Frame += 1;
+
+	TickClock(ClockTime);
+	TickClock(ClockFrame);
+}
+
+// the next activate time of the repeating timer, fire at most once per tick
+double FCallbackMgr::GetNextTime(const Callback& Item) const
+{
+	if (Item.Clock == ClockTime) {
+		double Earliest = std::nextafter(CurrentTime, std::numeric_limits<double>::infinity());
+		return FMath::Max(Item.Time + Item.Interval, Earliest);
+	}
+
+	double Interval = FMath::Max(FMath::FloorToDouble(Item.Interval), 1.);
+	return FMath::Max(Item.Time + Interval, (double)(Frame + 1));
+}
+
+void FCallbackMgr::TickClock(EClock Clock)
+{
+	TArray<Callback>& Heap = Heaps[Clock];
+
+	// the callback may add or cancel callbacks, update the heap before calling
+	while (Heap.Num() > 0 && IsDue(Heap[0])) {
+		if (Heap[0].Remaining == 1) {
+			Callback Item = RemoveAt(Clock, 0);
+			Item.Call();
+			Release(Item);
+			continue;
+		}
+
+		// repeat, reuse the slot and the function ref
+		Callback& Top = Heap[0];
+		if (Top.Remaining > 1) {
+			Top.Remaining -= 1;
+		}
+		Top.Time = GetNextTime(Top);
+		Top.Sequence = Sequence++;
+
+		Callback Item = Top;
+		SiftDown(Clock, 0);
+		Item.Call();
+	}
+}
+
+void FCallbackMgr::Push(const Callback& Item)
+{
+	TArray<Callback>& Heap = Heaps[Item.Clock];
+	int Index = Heap.Add(Item);
+	Slots.Add(Item.Id, CallbackSlot{ Item.Clock, Index });
+	if (Item.Owner) {
+		Owners.Add(Item.Owner, Item.Id);
+	}
+	SiftUp(Item.Clock, Index);
+}
 
-	// tick the fun
-	auto Iterator = Callbacks.begin();
-	while (Iterator != Callbacks.end()) {
-		if (Iterator->first < CurrentTime) {
-			// activate
-			Iterator->second.Call();
-			Callbacks.erase(Iterator);
+FCallbackMgr::Callback FCallbackMgr::RemoveAt(EClock Clock, int Index)
+{
+	TArray<Callback>& Heap = Heaps[Clock];
+	Callback Item = Heap[Index];
+	Slots.Remove(Item.Id);
+
+	Callback Last = Heap.Pop(false);
+	if (Index < Heap.Num()) {
+		Place(Clock, Index, Last);
+		SiftUp(Clock, Index);
+		SiftDown(Clock, Slots[Last.Id].Index);
+	}
+
+	return Item;
+}
+
+// the callback is removed from the heap, release the function and the owner
+void FCallbackMgr::Release(const Callback& Item)
+{
+	if (Item.Owner) {
+		Owners.RemoveSingle(Item.Owner, Item.Id);
+	}
+	luaL_unref(TLua::GetLuaState(), LUA_REGISTRYINDEX, Item.FunctionRef);
+}
+
+void FCallbackMgr::SiftUp(EClock Clock, int Index)
+{
+	TArray<Callback>& Heap = Heaps[Clock];
+	Callback Item = Heap[Index];
+	while (Index > 0) {
+		int Parent = (Index - 1) / 2;
+		if (!Less(Item, Heap[Parent])) {
+			break;
+		}
+		Place(Clock, Index, Heap[Parent]);
+		Index = Parent;
+	}
+	Place(Clock, Index, Item);
+}
 
-			// next iterator
-			Iterator = Callbacks.begin();
+void FCallbackMgr::SiftDown(EClock Clock, int Index)
+{
+	TArray<Callback>& Heap = Heaps[Clock];
+	Callback Item = Heap[Index];
+	int Num = Heap.Num();
+	while (true) {
+		int Child = Index * 2 + 1;
+		if (Child >= Num) {
+			break;
+		}
+		if (Child + 1 < Num && Less(Heap[Child + 1], Heap[Child])) {
+			Child += 1;
 		}
-		else {
-			break; // no callback activate
+		if (!Less(Heap[Child], Item)) {
+			break;
 		}
+		Place(Clock, Index, Heap[Child]);
+		Index = Child;
 	}
+	Place(Clock, Index, Item);
+}
+
+void FCallbackMgr::Place(EClock Clock, int Index, const Callback& Item)
+{
+	Heaps[Clock][Index] = Item;
+	Slots[Item.Id].Index = Index;
+}
+
+// tick manager
+FTickMgr::FTickMgr(int InNextId) : NextId(InNextId), Frame(0), bDirty(false)
+{
+}
+
+FTickMgr::~FTickMgr()
+{
+	Clear();
+}
+
+int FTickMgr::AddTick(lua_State* State, int Frames)
+{
+	Frames = FMath::Max(Frames, 1);
+	return Add(State, FindBucket(Frames, 0.));
+}
+
+int FTickMgr::AddFixedTick(lua_State* State, float Hz)
+{
+	if (Hz <= 0.f) {
+		return AddTick(State, 1);
+	}
+	return Add(State, FindBucket(0, 1. / Hz));
+}
+
+int FTickMgr::FindBucket(int Frames, double Period)
+{
+	for (int Index = 0; Index < Buckets.Num(); ++Index) {
+		if (Buckets[Index].Frames == Frames && Buckets[Index].Period == Period) {
+			return Index;
+		}
+	}
+
+	TickBucket& Bucket = Buckets.AddDefaulted_GetRef();
+	Bucket.Frames = Frames;
+	Bucket.Period = Period;
+	Bucket.Slots.SetNum(Frames ? Frames : 1);
+
+	return Buckets.Num() - 1;
+}
+
+// stack: ..., fun
+int FTickMgr::Add(lua_State* State, int BucketIndex)
+{
+	TickBucket& Bucket = Buckets[BucketIndex];
+
+	// stagger: put the function in the least loaded slot
+	int SlotIndex = 0;
+	for (int Index = 1; Index < Bucket.Slots.Num(); ++Index) {
+		if (Bucket.Slots[Index].Refs.Num() < Bucket.Slots[SlotIndex].Refs.Num()) {
+			SlotIndex = Index;
+		}
+	}
+	TickSlot& Slot = Bucket.Slots[SlotIndex];
+
+	int Id = NextId;
+	NextId += 1;
+
+	lua_pushvalue(State, -1);
+	Slot.Refs.Add(luaL_ref(State, LUA_REGISTRYINDEX));
+	Slot.Ids.Add(Id);
+
+	Locations.Add(Id, TickLocation{ BucketIndex, SlotIndex, Slot.Refs.Num() - 1 });
+
+	return Id;
+}
+
+void FTickMgr::Remove(int Handle)
+{
+	TickLocation Location;
+	if (!Locations.RemoveAndCopyValue(Handle, Location)) {
+		return;
+	}
+
+	// the slot may be ticking, compact it after the tick
+	TickSlot& Slot = Buckets[Location.Bucket].Slots[Location.Slot];
+	luaL_unref(TLua::GetLuaState(), LUA_REGISTRYINDEX, Slot.Refs[Location.Index]);
+	Slot.Refs[Location.Index] = LUA_NOREF;
+	Slot.bDirty = true;
+	bDirty = true;
+}
+
+void FTickMgr::Clear()
+{
+	if (Locations.Num() > 0) {
+		lua_State* State = TLua::GetLuaState();
+		for (TickBucket& Bucket : Buckets) {
+			for (TickSlot& Slot : Bucket.Slots) {
+				for (int Ref : Slot.Refs) {
+					luaL_unref(State, LUA_REGISTRYINDEX, Ref);
+				}
+			}
+		}
+	}
+
+	Buckets.Empty();
+	Locations.Empty();
+	bDirty = false;
+}
+
+void FTickMgr::Tick(float Delta)
+{
+	// the buckets may grow in the tick functions, access them by index
+	int BucketNum = Buckets.Num();
+	for (int BucketIndex = 0; BucketIndex < BucketNum; ++BucketIndex) {
+		for (TickSlot& Slot : Buckets[BucketIndex].Slots) {
+			Slot.Elapsed += Delta;
+		}
+
+		int Frames = Buckets[BucketIndex].Frames;
+		if (Frames > 0) {
+			int SlotIndex = Frame % Frames;
+			double Elapsed = Buckets[BucketIndex].Slots[SlotIndex].Elapsed;
+			Buckets[BucketIndex].Slots[SlotIndex].Elapsed = 0.;
+			TickFunctions(BucketIndex, SlotIndex, Elapsed);
+			continue;
+		}
+
+		// fixed rate, catch up at most a few steps after a hitch
+		double Period = Buckets[BucketIndex].Period;
+		for (int Step = 0; Step < 4 && Buckets[BucketIndex].Slots[0].Elapsed >= Period; ++Step) {
+			Buckets[BucketIndex].Slots[0].Elapsed -= Period;
+			TickFunctions(BucketIndex, 0, Period);
+		}
+		if (Buckets[BucketIndex].Slots[0].Elapsed >= Period) {
+			Buckets[BucketIndex].Slots[0].Elapsed = 0.;
+		}
+	}
+
+	++Frame;
+
+	if (bDirty) {
+		bDirty = false;
+		for (int BucketIndex = 0; BucketIndex < Buckets.Num(); ++BucketIndex) {
+			for (int SlotIndex = 0; SlotIndex < Buckets[BucketIndex].Slots.Num(); ++SlotIndex) {
+				Compact(BucketIndex, SlotIndex);
+			}
+		}
+	}
+}
+
+void FTickMgr::TickFunctions(int BucketIndex, int SlotIndex, float Delta)
+{
+	lua_State* State = TLua::GetLuaState();
+
+	// the functions added in the tick start from the next frame
+	int Num = Buckets[BucketIndex].Slots[SlotIndex].Refs.Num();
+	for (int Index = 0; Index < Num; ++Index) {
+		int Ref = Buckets[BucketIndex].Slots[SlotIndex].Refs[Index];
+		if (Ref == LUA_NOREF) {
+			continue;
+		}
+
+		int Handler = TLua::LuaPushTraceHandler(State);
+		lua_rawgeti(State, LUA_REGISTRYINDEX, Ref);
+		lua_pushnumber(State, Delta);
+		TLua::LuaTraceCall(State, Handler, 1);
+	}
+}
+
+void FTickMgr::Compact(int BucketIndex, int SlotIndex)
+{
+	TickSlot& Slot = Buckets[BucketIndex].Slots[SlotIndex];
+	if (!Slot.bDirty) {
+		return;
+	}
+	Slot.bDirty = false;
+
+	int Count = 0;
+	for (int Index = 0; Index < Slot.Refs.Num(); ++Index) {
+		if (Slot.Refs[Index] == LUA_NOREF) {
+			continue;
+		}
+
+		if (Count != Index) {
+			Slot.Refs[Count] = Slot.Refs[Index];
+			Slot.Ids[Count] = Slot.Ids[Index];
+			Locations[Slot.Ids[Count]].Index = Count;
+		}
+		++Count;
+	}
+
+	Slot.Refs.SetNum(Count, false);
+	Slot.Ids.SetNum(Count, false);
 }
 
 UTLuaCallback::UTLuaCallback() : CallbackContext(nullptr)
@@ -146,28 +468,32 @@ void UTLuaCallback::Bind(TLua::FunctionContext* InCallbackContext, int AbsIndex)
 void UTLuaCallback::Callback()
 {
 	lua_State* State = TLua::GetLuaState();
-	lua_getglobal(State, TLUA_TRACE_CALL_NAME);
+	int Handler = TLua::LuaPushTraceHandler(State);
 	lua_pushlightuserdata(State, this);
 	lua_gettable(State, LUA_REGISTRYINDEX);
 
-	lua_pcall(State, 1, 0, 0);
+	TLua::LuaTraceCall(State, Handler, 0);
 }
 
 void UTLuaCallback::ProcessEvent(UFunction* Function, void* Parameters)
 {
 	lua_State* State = TLua::GetLuaState();
-	lua_getglobal(State, TLUA_TRACE_CALL_NAME);
+	int Handler = TLua::LuaPushTraceHandler(State);
 	lua_pushlightuserdata(State, this);
 	lua_gettable(State, LUA_REGISTRYINDEX);
 
-	const int ExtraParameter = 1;
-
-	CallbackContext->CallLua(ExtraParameter, Parameters);
+	CallbackContext->CallLua(Handler, Parameters);
 }
 
 UTLuaRootObject::UTLuaRootObject()
 {
 	TickFunction.Owner = this;
+
+	EndTickFunction.Owner = this;
+	EndTickFunction.bEndOfFrame = true;
+	EndTickFunction.TickGroup = TG_PostUpdateWork;
+	// the gc steps are the only collection while the scheduler is attached
+	EndTickFunction.bTickEvenWhenPaused = true;
 }
 
 int UTLuaRootObject::AddCallback(lua_State* State)
@@ -180,6 +506,31 @@ void UTLuaRootObject::CancelCallback(int Handle)
 	CallbackMgr.Cancel(Handle);
 }
 
+int UTLuaRootObject::AddTimer(lua_State* State, FCallbackMgr::EClock Clock, double Delay, double Interval, int Count, const UObject* Owner)
+{
+	return CallbackMgr.AddTimer(State, Clock, Delay, Interval, Count, Owner);
+}
+
+int UTLuaRootObject::CancelOwnerCallbacks(const UObject* Owner)
+{
+	return CallbackMgr.CancelOwner(Owner);
+}
+
+int UTLuaRootObject::AddTick(lua_State* State, int Frames)
+{
+	return TickMgr.AddTick(State, Frames);
+}
+
+int UTLuaRootObject::AddFixedTick(lua_State* State, float Hz)
+{
+	return TickMgr.AddFixedTick(State, Hz);
+}
+
+void UTLuaRootObject::RemoveTick(int Handle)
+{
+	TickMgr.Remove(Handle);
+}
+
 void UTLuaRootObject::Activate()
 {
 	UWorld* World = GetWorld();
@@ -190,9 +541,34 @@ void UTLuaRootObject::Activate()
 	if (!TickFunction.IsTickFunctionRegistered()) {
 		TickFunction.RegisterTickFunction(World->PersistentLevel);
 	}
+	if (!EndTickFunction.IsTickFunctionRegistered()) {
+		EndTickFunction.RegisterTickFunction(World->PersistentLevel);
+	}
+}
+
+void UTLuaRootObject::Deactivate()
+{
+	if (TickFunction.IsTickFunctionRegistered()) {
+		TickFunction.UnRegisterTickFunction();
+	}
+	if (EndTickFunction.IsTickFunctionRegistered()) {
+		EndTickFunction.UnRegisterTickFunction();
+	}
+
+	// no more end of frame steps, the collector of lua takes over
+	TLua::GCScheduler::Get().Detach(TLua::GetLuaState());
 }
 
 void UTLuaRootObject::Tick(float Delta)
 {
 	CallbackMgr.Tick(Delta);
+	TickMgr.Tick(Delta);
+}
+
+void UTLuaRootObject::EndTick(float Delta)
+{
+	lua_State* State = TLua::GetLuaState();
+
+	TLua::GCScheduler::Get().Step(State, Delta);
+	TLua::UpdateMemoryStats(State, Delta);
 }
@@ -1,6 +1,5 @@
 #pragma once
 
-#include <map>
 #include "Lua/lua.hpp"
 #include "TLuaCppLua.hpp"
 
@@ -24,6 +23,8 @@ public:
 
 public:
 	UTLuaRootObject* Owner;
+	// tick at the end of the frame, call UTLuaRootObject::EndTick
+	bool bEndOfFrame;
 };
 
 UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
@@ -46,36 +47,144 @@ public:
 	TLua::FunctionContext* CallbackContext;
 };
 
+// the timers are kept in binary heaps ordered by the activate time (or frame),
+// the heap index of every timer is tracked by id, so cancel is O(log n).
+// a repeating timer keeps its slot and function ref across the firings.
 class FCallbackMgr
 {
+public:
+	enum EClock : uint8
+	{
+		ClockTime,		// seconds
+		ClockFrame,		// frame count
+		ClockNum,
+	};
+
+private:
 	struct Callback
 	{
+		double Time;		// activate time, or activate frame of the frame clock
+		double Interval;
+		uint64 Sequence;	// same time, fire in the order of adding
+		const UObject* Owner;
 		int Id;
-		void* Key;
+		int FunctionRef;
+		int Remaining;		// firings left, 0 for forever
+		EClock Clock;
 
-	public:
-		inline Callback() : Id(0), Key(nullptr){}
+		void Call() const;
+	};
 
-		~Callback();
-		void Bind();
-		void Call();
+	struct CallbackSlot
+	{
+		EClock Clock;
+		int Index;
 	};
 
-	using CallbackMap = std::multimap<double, Callback>;
 public:
 	explicit FCallbackMgr(int NextId = 100);
+	~FCallbackMgr();
 
 	// add_callback(..., duration, fun)
 	int AddCallback(lua_State* State);
+	// stack: ..., fun
+	// fire after the delay, then every interval until fired Count times (0 for forever)
+	int AddTimer(lua_State* State, EClock Clock, double Delay, double Interval, int Count, const UObject* Owner);
 	void Cancel(int Handle);
+	// cancel all the callbacks of the owner, return the number of them
+	int CancelOwner(const UObject* Owner);
 	void Clear();
 	void Tick(float Delta);
 
+	inline int Num() const
+	{
+		return Slots.Num();
+	}
+
+private:
+	inline bool Less(const Callback& A, const Callback& B) const
+	{
+		return A.Time < B.Time || (A.Time == B.Time && A.Sequence < B.Sequence);
+	}
+
+	inline bool IsDue(const Callback& Item) const
+	{
+		return Item.Clock == ClockTime ? Item.Time < CurrentTime : Item.Time <= (double)Frame;
+	}
+
+	double GetNextTime(const Callback& Item) const;
+	void TickClock(EClock Clock);
+	void Push(const Callback& Item);
+	Callback RemoveAt(EClock Clock, int Index);
+	void Release(const Callback& Item);
+	void SiftUp(EClock Clock, int Index);
+	void SiftDown(EClock Clock, int Index);
+	void Place(EClock Clock, int Index, const Callback& Item);
+
 private:
 	int NextId;
+	uint64 Sequence;
 	double CurrentTime;
-//	std::multimap<double, Callback> Callbacks;
-	CallbackMap Callbacks;
+	uint64 Frame;
+	TArray<Callback> Heaps[ClockNum];
+	TMap<int, CallbackSlot> Slots;	// id -> slot of the heap
+	TMultiMap<const UObject*, int> Owners;
+};
+
+// tick the lua functions from the root tick function, scripts don't need their own FTickFunction.
+// the functions are grouped in buckets: every frame, every N frames, or at a fixed rate.
+class FTickMgr
+{
+	struct TickSlot
+	{
+		TArray<int> Refs;		// registry refs of the tick functions, LUA_NOREF for the removed one
+		TArray<int> Ids;
+		double Elapsed = 0.;
+		bool bDirty = false;
+	};
+
+	struct TickBucket
+	{
+		int Frames = 0;			// tick every N frames, the functions are staggered over N slots
+		double Period = 0.;		// tick at a fixed rate if Frames is 0
+		TArray<TickSlot> Slots;
+	};
+
+	struct TickLocation
+	{
+		int Bucket;
+		int Slot;
+		int Index;
+	};
+public:
+	explicit FTickMgr(int NextId = 100);
+	~FTickMgr();
+
+	// stack: ..., fun
+	int AddTick(lua_State* State, int Frames);
+	// stack: ..., fun
+	int AddFixedTick(lua_State* State, float Hz);
+	void Remove(int Handle);
+	void Clear();
+	void Tick(float Delta);
+
+	inline int Num() const
+	{
+		return Locations.Num();
+	}
+
+private:
+	int FindBucket(int Frames, double Period);
+	int Add(lua_State* State, int BucketIndex);
+	void TickFunctions(int BucketIndex, int SlotIndex, float Delta);
+	void Compact(int BucketIndex, int SlotIndex);
+
+private:
+	int NextId;
+	uint64 Frame;
+	bool bDirty;
+	TArray<TickBucket> Buckets;
+	TMap<int, TickLocation> Locations;
 };
 
 UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
@@ -87,10 +196,23 @@ public:
 
 	int AddCallback(lua_State* State);
 	void CancelCallback(int Handle);
+	// stack: ..., fun
+	int AddTimer(lua_State* State, FCallbackMgr::EClock Clock, double Delay, double Interval, int Count, const UObject* Owner);
+	int CancelOwnerCallbacks(const UObject* Owner);
+	// stack: ..., fun
+	int AddTick(lua_State* State, int Frames);
+	// stack: ..., fun
+	int AddFixedTick(lua_State* State, float Hz);
+	void RemoveTick(int Handle);
 	void Activate();
+	void Deactivate();
 	void Tick(float Delta);
+	// the gc steps and the memory stats after the world ticked
+	void EndTick(float Delta);
 
 private:
 	FCallbackMgr CallbackMgr;
+	FTickMgr TickMgr;
 	FRootTickFunction TickFunction;
+	FRootTickFunction EndTickFunction;
 };
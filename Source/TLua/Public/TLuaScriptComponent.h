@@ -32,7 +32,8 @@ public:
 			return;
 		}
 
-		TLua::Call("_lua_tcall", (void*)Owner, Name, Args...);
+		static TLua::FunctionHandle Handle("_lua_tcall");
+		Handle.Call((void*)Owner, Name, Args...);
 	}
 
 	template <typename ...ArgTypes>
@@ -43,7 +44,8 @@ public:
 			return;
 		}
 
-		TLua::Call("_lua_call", (void*)Owner, Name, Args...);
+		static TLua::FunctionHandle Handle("_lua_call");
+		Handle.Call((void*)Owner, Name, Args...);
 	}
 
 	template <typename ReturnType, typename ...ArgTypes>
@@ -54,7 +56,20 @@ public:
 			return ReturnType();
 		}
 
-		return TLua::RCall<ReturnType>("_lua_call", (void*)Owner, Name, Args...);
+		static TLua::FunctionHandle Handle("_lua_call");
+		return Handle.RCall<ReturnType>((void*)Owner, Name, Args...);
+	}
+
+	// gather the call into the batch, it's called when the batch is flushed
+	template <typename ...ArgTypes>
+	void BatchCall(TLua::BatchCall& Batch, const char* Name, const ArgTypes&... Args)
+	{
+		AActor* Owner = GetOwner();
+		if (!Owner) {
+			return;
+		}
+
+		Batch.Add(Owner, Name, Args...);
 	}
 
 	virtual void BindOwner(AActor* Owner);
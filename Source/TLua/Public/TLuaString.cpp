@@ -0,0 +1,173 @@
+#include "TLuaString.hpp"
+
+#include "Containers/StringConv.h"
+
+#define TLUA_STRING_SSE2 (PLATFORM_ENABLE_VECTORINTRINSICS && PLATFORM_CPU_X86_FAMILY)
+
+// the cached name strings, the table is dropped when it's full
+#define TLUA_NAME_CACHE_SIZE 8192
+
+#if TLUA_STRING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace TLua
+{
+	// registry[&NameStringsKey] = { [display index] = string }, the names without number
+	static char NameStringsKey;
+	static int32 NameStringsNum = 0;
+
+	bool IsAscii(const char* Data, size_t Size)
+	{
+		const uint8* Bytes = (const uint8*)Data;
+		size_t Index = 0;
+
+#if TLUA_STRING_SSE2
+		for (; Index + 16 <= Size; Index += 16) {
+			__m128i Chunk = _mm_loadu_si128((const __m128i*)(Bytes + Index));
+			if (_mm_movemask_epi8(Chunk) != 0) {
+				return false;
+			}
+		}
+#endif
+
+		for (; Index + 8 <= Size; Index += 8) {
+			uint64 Word;
+			FMemory::Memcpy(&Word, Bytes + Index, sizeof(Word));
+			if (Word & 0x8080808080808080ull) {
+				return false;
+			}
+		}
+
+		for (; Index < Size; ++Index) {
+			if (Bytes[Index] & 0x80) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool IsAscii(const TCHAR* Data, int32 Len)
+	{
+		int32 Index = 0;
+
+		if constexpr (sizeof(TCHAR) == 2) {
+#if TLUA_STRING_SSE2
+			const __m128i Mask = _mm_set1_epi16((short)0xFF80);
+			for (; Index + 8 <= Len; Index += 8) {
+				__m128i Chunk = _mm_loadu_si128((const __m128i*)(Data + Index));
+				if (_mm_movemask_epi8(_mm_and_si128(Chunk, Mask)) != 0) {
+					return false;
+				}
+			}
+#endif
+
+			for (; Index + 4 <= Len; Index += 4) {
+				uint64 Word;
+				FMemory::Memcpy(&Word, Data + Index, sizeof(Word));
+				if (Word & 0xFF80FF80FF80FF80ull) {
+					return false;
+				}
+			}
+		}
+
+		for (; Index < Len; ++Index) {
+			if ((uint32)Data[Index] >= 0x80) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	FString ToFString(lua_State* State, int Index)
+	{
+		size_t Size = 0;
+		const char* Buffer = lua_tolstring(State, Index, &Size);
+		if (!Buffer || Size == 0) {
+			return FString();
+		}
+
+#if TLUA_STRING_UTF8
+		// widen the ascii in place, no decoding
+		if (IsAscii(Buffer, Size)) {
+			FString Result;
+			TArray<TCHAR>& Chars = Result.GetCharArray();
+			Chars.SetNumUninitialized((int32)Size + 1);
+
+			TCHAR* Dest = Chars.GetData();
+			for (size_t CharIndex = 0; CharIndex < Size; ++CharIndex) {
+				Dest[CharIndex] = (TCHAR)Buffer[CharIndex];
+			}
+			Dest[Size] = 0;
+			return Result;
+		}
+
+		FUTF8ToTCHAR Convert((const UTF8CHAR*)Buffer, (int32)Size);
+		return FString(Convert.Length(), Convert.Get());
+#else
+		return FString::ConstructFromPtrSize((const TCHAR*)Buffer, Size / sizeof(TCHAR));
+#endif
+	}
+
+	void PushFString(lua_State* State, const TCHAR* Data, int32 Len)
+	{
+#if TLUA_STRING_UTF8
+		if (IsAscii(Data, Len)) {
+			TArray<ANSICHAR, TInlineAllocator<256>> Narrow;
+			Narrow.SetNumUninitialized(Len);
+
+			ANSICHAR* Dest = Narrow.GetData();
+			for (int32 CharIndex = 0; CharIndex < Len; ++CharIndex) {
+				Dest[CharIndex] = (ANSICHAR)Data[CharIndex];
+			}
+			lua_pushlstring(State, Dest, Len);
+			return;
+		}
+
+		FTCHARToUTF8 Convert(Data, Len);
+		lua_pushlstring(State, (const char*)Convert.Get(), Convert.Length());
+#else
+		lua_pushlstring(State, (const char*)Data, Len * sizeof(TCHAR));
+#endif
+	}
+
+	void PushName(lua_State* State, FName Name)
+	{
+		// the numbered names (Actor_123) are endless, build them on the fly
+		if (Name.GetNumber() != NAME_NO_NUMBER_INTERNAL) {
+			FString String = Name.ToString();
+			PushFString(State, *String, String.Len());
+			return;
+		}
+
+		// the display index keeps the case of the name
+		lua_Integer Key = (lua_Integer)Name.GetDisplayIndex().ToUnstableInt();
+
+		lua_rawgetp(State, LUA_REGISTRYINDEX, &NameStringsKey);		// strings
+		if (lua_rawgeti(State, -1, Key) != LUA_TSTRING) {			// strings, string
+			lua_pop(State, 1);
+
+			// bound the cache, start a new table when it's full
+			if (++NameStringsNum > TLUA_NAME_CACHE_SIZE) {
+				lua_pop(State, 1);
+				lua_newtable(State);
+				lua_pushvalue(State, -1);
+				lua_rawsetp(State, LUA_REGISTRYINDEX, &NameStringsKey);
+				NameStringsNum = 1;
+			}
+
+			FString String = Name.ToString();
+			PushFString(State, *String, String.Len());
+			lua_pushvalue(State, -1);
+			lua_rawseti(State, -3, Key);
+		}
+		lua_remove(State, -2);										// string
+	}
+
+	void RegisterString(lua_State* State)
+	{
+		lua_newtable(State);
+		lua_rawsetp(State, LUA_REGISTRYINDEX, &NameStringsKey);
+		NameStringsNum = 0;
+	}
+}
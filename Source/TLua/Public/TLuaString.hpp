@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+
+// the encoding of the strings cross the boundary
+// 1: lua holds utf8 everywhere, FString is converted once at TypeInfo<FString>
+// 0: the lua string holds the raw TCHAR bytes, the scripts convert by
+//    _cpp_utf8_to_utf16/_cpp_utf16_to_utf8
+#ifndef TLUA_STRING_UTF8
+#define TLUA_STRING_UTF8 1
+#endif
+
+namespace TLua
+{
+	// true if all the chars are 7 bit, checked 16 bytes at a time
+	TLua_API bool IsAscii(const char* Data, size_t Size);
+	TLua_API bool IsAscii(const TCHAR* Data, int32 Len);
+
+	// the string at the index in the boundary encoding
+	TLua_API FString ToFString(lua_State* State, int Index);
+	TLua_API void PushFString(lua_State* State, const TCHAR* Data, int32 Len);
+
+	// push the name in the boundary encoding, the names without number are converted once,
+	// the numbered ones every time
+	TLua_API void PushName(lua_State* State, FName Name);
+
+	void RegisterString(lua_State* State);
+}
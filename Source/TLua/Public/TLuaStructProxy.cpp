@@ -0,0 +1,318 @@
+#include "TLuaStructProxy.hpp"
+
+#include <cstring>
+
+#include "TLua.h"
+#include "TLuaContainerView.hpp"
+#include "TLuaMemberCache.hpp"
+#include "TLuaProperty.hpp"
+
+// metatable slots of the struct proxy
+#define TLUA_STRUCT_MEMBERS_INDEX 1		// name -> processor
+#define TLUA_STRUCT_CTYPE_INDEX 2		// UScriptStruct*
+
+namespace TLua
+{
+	// registry[&MetatablesKey] = { [UScriptStruct*] = metatable }
+	static char MetatablesKey;
+	// metatable[&StructProxyTag] = true
+	static char StructProxyTag;
+
+	static inline SIZE_T GetValueAlignment(const UScriptStruct* Struct)
+	{
+		return (SIZE_T)FMath::Max(Struct->GetMinAlignment(), 1);
+	}
+
+	// the userdata is only aligned to LUAI_MAXALIGN, align the absolute address,
+	// the copy is allocated with alignment - 1 bytes more
+	static inline uint8* GetInlineValue(const StructProxy* Proxy, const UScriptStruct* Struct)
+	{
+		return Align((uint8*)Proxy + sizeof(StructProxy), GetValueAlignment(Struct));
+	}
+
+	static inline bool IsInlineValue(const StructProxy* Proxy)
+	{
+		return Proxy->Value == GetInlineValue(Proxy, Proxy->Struct);
+	}
+
+	static inline bool NeedDestroy(const UScriptStruct* Struct)
+	{
+		return (Struct->StructFlags & (STRUCT_IsPlainOldData | STRUCT_NoDestructor)) == 0;
+	}
+
+	// __index(proxy, key)
+	static int CppStructIndex(lua_State* State)
+	{
+		lua_settop(State, 2);
+		lua_getmetatable(State, 1);									// proxy, key, mt
+		lua_rawgeti(State, 3, TLUA_STRUCT_MEMBERS_INDEX);			// proxy, key, mt, members
+		lua_pushvalue(State, 2);
+
+		StructProxy* Proxy = (StructProxy*)lua_touserdata(State, 1);
+		if (lua_rawget(State, 4) == LUA_TLIGHTUSERDATA) {			// proxy, key, mt, members, member
+			CheckReference(State, 1);
+			PropertyProcessor* Processor = (PropertyProcessor*)lua_touserdata(State, 5);
+			Processor->ToLua(State, Proxy->Value);
+
+			// the nested struct and container reference the memory of this proxy
+			BindOwner(State, 1);
+			return 1;
+		}
+
+		// compatible with the scripts use the raw pointer
+		if (lua_type(State, 2) == LUA_TSTRING && strcmp(lua_tostring(State, 2), "_co") == 0) {
+			lua_pushlightuserdata(State, Proxy->Value);
+			return 1;
+		}
+
+		lua_pushnil(State);
+		return 1;
+	}
+
+	// __newindex(proxy, key, value)
+	static int CppStructNewIndex(lua_State* State)
+	{
+		lua_settop(State, 3);
+		lua_getmetatable(State, 1);									// proxy, key, value, mt
+		lua_rawgeti(State, 4, TLUA_STRUCT_MEMBERS_INDEX);			// proxy, key, value, mt, members
+		lua_pushvalue(State, 2);
+
+		if (lua_rawget(State, 5) != LUA_TLIGHTUSERDATA) {			// proxy, key, value, mt, members, member
+			return luaL_error(State, "no member '%s' in %s", lua_tostring(State, 2), luaL_typename(State, 1));
+		}
+
+		CheckReference(State, 1);
+		StructProxy* Proxy = (StructProxy*)lua_touserdata(State, 1);
+		PropertyProcessor* Processor = (PropertyProcessor*)lua_touserdata(State, 6);
+		Processor->FromLua(State, 3, Proxy->Value);
+
+		return 0;
+	}
+
+	// __tostring(proxy)
+	static int CppStructToString(lua_State* State)
+	{
+		StructProxy* Proxy = (StructProxy*)lua_touserdata(State, 1);
+
+		FTCHARToUTF8 Convert(Proxy->Struct->GetName());
+		lua_pushfstring(State, "%s: %p", (const char*)Convert.Get(), Proxy->Value);
+		return 1;
+	}
+
+	// __gc(proxy), only the struct need the destructor
+	static int CppStructGC(lua_State* State)
+	{
+		StructProxy* Proxy = (StructProxy*)lua_touserdata(State, 1);
+		if (IsInlineValue(Proxy)) {
+			Proxy->Struct->DestroyStruct(Proxy->Value);
+		}
+		return 0;
+	}
+
+	// stack: ..., mt -> ..., mt, the accessors of the properties
+	static void SetStructMembers(lua_State* State, UScriptStruct* Struct)
+	{
+		lua_newtable(State);										// mt, members
+		for (TFieldIterator<FProperty> It(Struct); It; ++It) {
+			const MemberInfo& Info = MemberCache::Get().Find(Struct, It->GetFName());
+			if (!Info.Processor) {
+				continue;
+			}
+
+			FTCHARToUTF8 Convert(It->GetName());
+			lua_pushlstring(State, (const char*)Convert.Get(), Convert.Length());
+			lua_pushlightuserdata(State, Info.Processor);
+			lua_rawset(State, -3);
+		}
+		lua_rawseti(State, -2, TLUA_STRUCT_MEMBERS_INDEX);			// mt
+	}
+
+	// stack: ..., metatables -> ..., metatables, metatable
+	static void NewStructMetatable(lua_State* State, UScriptStruct* Struct)
+	{
+		lua_createtable(State, 2, 6);
+
+		lua_pushboolean(State, 1);
+		lua_rawsetp(State, -2, &StructProxyTag);
+
+		SetStructMembers(State, Struct);							// metatables, mt
+
+		lua_pushlightuserdata(State, Struct);
+		lua_rawseti(State, -2, TLUA_STRUCT_CTYPE_INDEX);
+
+		FTCHARToUTF8 Convert(Struct->GetName());
+		lua_pushlstring(State, (const char*)Convert.Get(), Convert.Length());
+		lua_setfield(State, -2, "__name");
+
+		lua_pushcfunction(State, CppStructIndex);
+		lua_setfield(State, -2, "__index");
+		lua_pushcfunction(State, CppStructNewIndex);
+		lua_setfield(State, -2, "__newindex");
+		lua_pushcfunction(State, CppStructToString);
+		lua_setfield(State, -2, "__tostring");
+
+		// the plain old data needs no finalizer
+		if (NeedDestroy(Struct)) {
+			lua_pushcfunction(State, CppStructGC);
+			lua_setfield(State, -2, "__gc");
+		}
+	}
+
+	// stack: ... -> ..., metatable
+	static void PushStructMetatable(lua_State* State, UScriptStruct* Struct)
+	{
+		MemberCache::Get().FlushDeleted();
+
+		lua_rawgetp(State, LUA_REGISTRYINDEX, &MetatablesKey);		// metatables
+		if (lua_rawgetp(State, -1, Struct) != LUA_TTABLE) {			// metatables, mt
+			lua_pop(State, 1);
+			MemberCache::Get().Track(Struct);
+			NewStructMetatable(State, Struct);
+			lua_pushvalue(State, -1);
+			lua_rawsetp(State, -3, Struct);
+		}
+		lua_remove(State, -2);										// mt
+	}
+
+	void RemoveStructMetatable(lua_State* State, const UStruct* Struct)
+	{
+		if (lua_rawgetp(State, LUA_REGISTRYINDEX, &MetatablesKey) == LUA_TTABLE) {
+			lua_pushnil(State);
+			lua_rawsetp(State, -2, Struct);
+		}
+		lua_pop(State, 1);
+	}
+
+	void ResetStructMembers(lua_State* State, const UStruct* Struct)
+	{
+		if (lua_rawgetp(State, LUA_REGISTRYINDEX, &MetatablesKey) != LUA_TTABLE) {
+			lua_pop(State, 1);
+			return;
+		}
+
+		lua_pushnil(State);											// metatables, nil
+		while (lua_next(State, -2)) {								// metatables, struct, mt
+			UScriptStruct* ScriptStruct = (UScriptStruct*)lua_touserdata(State, -2);
+			if (ScriptStruct->IsChildOf(Struct)) {
+				SetStructMembers(State, ScriptStruct);
+			}
+			lua_pop(State, 1);										// metatables, struct
+		}
+		lua_pop(State, 1);
+	}
+
+	void* PushStructCopy(lua_State* State, UScriptStruct* Struct, const void* Value)
+	{
+		SIZE_T Size = sizeof(StructProxy) + GetValueAlignment(Struct) - 1 + Struct->GetStructureSize();
+		StructProxy* Proxy = (StructProxy*)lua_newuserdatauv(State, Size, 0);
+		Proxy->Slot = { nullptr, INDEX_NONE };
+		Proxy->Struct = Struct;
+		Proxy->Value = GetInlineValue(Proxy, Struct);
+
+		if (Value && (Struct->StructFlags & STRUCT_IsPlainOldData)) {
+			FMemory::Memcpy(Proxy->Value, Value, Struct->GetStructureSize());
+		}
+		else {
+			Struct->InitializeStruct(Proxy->Value);
+			if (Value) {
+				Struct->CopyScriptStruct(Proxy->Value, Value);
+			}
+		}
+
+		// set the metatable after the value is constructed, __gc destroy it
+		PushStructMetatable(State, Struct);
+		lua_setmetatable(State, -2);
+
+		return Proxy->Value;
+	}
+
+	void PushStructRef(lua_State* State, UScriptStruct* Struct, void* Value)
+	{
+		if (!Value) {
+			lua_pushnil(State);
+			return;
+		}
+
+		StructProxy* Proxy = (StructProxy*)lua_newuserdatauv(State, sizeof(StructProxy), 1);
+		Proxy->Slot = { nullptr, INDEX_NONE };
+		Proxy->Struct = Struct;
+		Proxy->Value = Value;
+
+		PushStructMetatable(State, Struct);
+		lua_setmetatable(State, -2);
+	}
+
+	StructProxy* ToStructProxy(lua_State* State, int Index)
+	{
+		if (lua_type(State, Index) != LUA_TUSERDATA || !lua_getmetatable(State, Index)) {
+			return nullptr;
+		}
+
+		lua_rawgetp(State, -1, &StructProxyTag);
+		bool IsProxy = lua_toboolean(State, -1);
+		lua_pop(State, 2);
+
+		return IsProxy ? (StructProxy*)lua_touserdata(State, Index) : nullptr;
+	}
+
+	void* GetStructValue(lua_State* State, int Index, const UScriptStruct* Struct)
+	{
+		StructProxy* Proxy = ToStructProxy(State, Index);
+		if (!Proxy) {
+			return nullptr;
+		}
+
+		if (Proxy->Struct != Struct && !Proxy->Struct->IsChildOf(Struct)) {
+			return nullptr;
+		}
+		CheckReference(State, Index);
+		return Proxy->Value;
+	}
+
+	// _cpp_struct_new(ctype) -> proxy
+	static int CppStructNew(lua_State* State)
+	{
+		UScriptStruct* Struct = (UScriptStruct*)lua_touserdata(State, 1);
+		if (!Struct) {
+			return luaL_error(State, "invalid struct type");
+		}
+
+		PushStructCopy(State, Struct);
+		return 1;
+	}
+
+	// _cpp_struct_copy(proxy) -> proxy
+	static int CppStructCopy(lua_State* State)
+	{
+		StructProxy* Proxy = ToStructProxy(State, 1);
+		if (!Proxy) {
+			return luaL_typeerror(State, 1, "struct");
+		}
+		CheckReference(State, 1);
+
+		PushStructCopy(State, Proxy->Struct, Proxy->Value);
+		return 1;
+	}
+
+	// _cpp_struct_get_type(proxy) -> ctype
+	static int CppStructGetType(lua_State* State)
+	{
+		StructProxy* Proxy = ToStructProxy(State, 1);
+		if (!Proxy) {
+			return 0;
+		}
+
+		lua_pushlightuserdata(State, Proxy->Struct);
+		return 1;
+	}
+
+	void RegisterStructProxy(lua_State* State)
+	{
+		lua_newtable(State);
+		lua_rawsetp(State, LUA_REGISTRYINDEX, &MetatablesKey);
+
+		lua_register(State, "_cpp_struct_new", CppStructNew);
+		lua_register(State, "_cpp_struct_copy", CppStructCopy);
+		lua_register(State, "_cpp_struct_get_type", CppStructGetType);
+	}
+}
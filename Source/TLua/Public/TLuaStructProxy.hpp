@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "UObject/Class.h"
+
+#include "TLuaContainerView.hpp"
+
+namespace TLua
+{
+	// full userdata of the UScriptStruct, shared the metatable with the same struct.
+	// the value is stored inline after the header, or references the memory of the owner.
+	// user value 1: the owner of the referenced memory, keep it alive.
+	struct StructProxy
+	{
+		ElementSlot Slot;				// the first member, shared with ContainerView
+		UScriptStruct* Struct;
+		void* Value;
+	};
+
+	// push a copy of the value (initialized value for nullptr), return the memory of the copy
+	TLua_API void* PushStructCopy(lua_State* State, UScriptStruct* Struct, const void* Value = nullptr);
+
+	// push a reference to the value, the memory must outlive the proxy
+	TLua_API void PushStructRef(lua_State* State, UScriptStruct* Struct, void* Value);
+
+	// return the proxy at the index, nullptr if it's not a struct proxy
+	TLua_API StructProxy* ToStructProxy(lua_State* State, int Index);
+
+	// return the value of the struct (or the child struct), nullptr if it's not a proxy of it
+	TLua_API void* GetStructValue(lua_State* State, int Index, const UScriptStruct* Struct);
+
+	// rebuild the members in the metatables of the struct and the child structs
+	void ResetStructMembers(lua_State* State, const UStruct* Struct);
+
+	// drop the metatable of the deleted struct
+	void RemoveStructMetatable(lua_State* State, const UStruct* Struct);
+
+	void RegisterStructProxy(lua_State* State);
+}
@@ -0,0 +1,53 @@
+#include "TLuaTrace.hpp"
+
+#include "UObject/Class.h"
+#include "UObject/UnrealType.h"
+
+UE_TRACE_CHANNEL_DEFINE(TLuaChannel);
+
+namespace TLua
+{
+	// only the game thread crosses the boundary
+	static TMap<FString, uint32> LuaSpecIds;
+	static TMap<const void*, uint32> ObjectSpecIds;
+
+	uint32 TraceScope::GetSpecId(const char* LuaName)
+	{
+		FString Name(UTF8_TO_TCHAR(LuaName));
+		if (const uint32* SpecId = LuaSpecIds.Find(Name)) {
+			return *SpecId;
+		}
+
+		uint32 SpecId = FCpuProfilerTrace::OutputEventType(*FString::Printf(TEXT("Lua: %s"), *Name));
+		LuaSpecIds.Add(Name, SpecId);
+		return SpecId;
+	}
+
+	uint32 TraceScope::GetSpecId(const UFunction* Function)
+	{
+		if (const uint32* SpecId = ObjectSpecIds.Find(Function)) {
+			return *SpecId;
+		}
+
+		FString Name = FString::Printf(TEXT("UFunction: %s::%s"), *Function->GetOuter()->GetName(), *Function->GetName());
+		uint32 SpecId = FCpuProfilerTrace::OutputEventType(*Name);
+		ObjectSpecIds.Add(Function, SpecId);
+		return SpecId;
+	}
+
+	uint32 TraceScope::GetSpecId(const FProperty* Property, bool bSet)
+	{
+		// the setter is keyed by the odd address
+		const void* Key = (const uint8*)Property + (bSet ? 1 : 0);
+		if (const uint32* SpecId = ObjectSpecIds.Find(Key)) {
+			return *SpecId;
+		}
+
+		UObject* Owner = Property->GetOwnerUObject();
+		FString Name = FString::Printf(TEXT("%s: %s::%s"), bSet ? TEXT("Set") : TEXT("Get"),
+			Owner ? *Owner->GetName() : TEXT("?"), *Property->GetName());
+		uint32 SpecId = FCpuProfilerTrace::OutputEventType(*Name);
+		ObjectSpecIds.Add(Key, SpecId);
+		return SpecId;
+	}
+}
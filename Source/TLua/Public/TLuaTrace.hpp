@@ -0,0 +1,63 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Trace/Trace.h"
+
+// the Insights channel of the lua events, enable it by -trace=cpu,TLua
+UE_TRACE_CHANNEL_EXTERN(TLuaChannel, TLua_API);
+
+namespace TLua
+{
+	// cpu profiler event of the boundary crossing, the event types are registered
+	// on the first use of each name. the lua error longjmps over the destructor,
+	// never enclose the code that can raise (the conversion from lua) in the scope.
+	class TLua_API TraceScope
+	{
+	public:
+		// SpecId 0: nothing is traced
+		explicit inline TraceScope(uint32 SpecId) : bActive(SpecId != 0)
+		{
+			if (bActive) {
+				FCpuProfilerTrace::OutputBeginEvent(SpecId);
+			}
+		}
+
+		inline ~TraceScope()
+		{
+			if (bActive) {
+				FCpuProfilerTrace::OutputEndEvent();
+			}
+		}
+
+		// the global lua function
+		static uint32 GetSpecId(const char* LuaName);
+		static uint32 GetSpecId(const UFunction* Function);
+		static uint32 GetSpecId(const FProperty* Property, bool bSet);
+
+	private:
+		bool bActive;
+	};
+}
+
+namespace TLua
+{
+	// the trace scopes record the events
+	inline bool IsTraceEnabled()
+	{
+#if CPUPROFILERTRACE_ENABLED
+		return UE_TRACE_CHANNELEXPR_IS_ENABLED(CpuChannel | TLuaChannel);
+#else
+		return false;
+#endif
+	}
+}
+
+// the arguments (name, UFunction* or FProperty*, bSet) are only evaluated when the channel is on
+#if CPUPROFILERTRACE_ENABLED
+#define TLUA_TRACE_SCOPE(...) \
+	TLua::TraceScope PREPROCESSOR_JOIN(TLuaTraceScope_, __LINE__)( \
+		UE_TRACE_CHANNELEXPR_IS_ENABLED(CpuChannel | TLuaChannel) ? TLua::TraceScope::GetSpecId(__VA_ARGS__) : 0)
+#else
+#define TLUA_TRACE_SCOPE(...)
+#endif
@@ -2,6 +2,11 @@
 
 #include "Lua/lua.hpp"
 #include "TLuaImp.hpp"
+#include "TLuaNameCache.hpp"
+#include "TLuaObjectProxy.hpp"
+#include "TLuaString.hpp"
+#include "TLuaStructProxy.hpp"
+#include "TLuaValueTypes.hpp"
 
 namespace TLua
 {
@@ -192,16 +197,15 @@ namespace TLua
 			OutValue = FromLua(State, Index);
 		}
 
+		// in the boundary encoding, see TLUA_STRING_UTF8
 		inline static FString FromLua(lua_State* State, int Index)
 		{
-			size_t Size = 0;
-			const TCHAR* Buffer = (const TCHAR*)LuaGetLString(State, Index, Size);
-			return FString::ConstructFromPtrSize(Buffer, Size/sizeof(TCHAR));
+			return ToFString(State, Index);
 		}
 
 		inline static void ToLua(lua_State* State, const FString& Value)
 		{
-			LuaPushLString(State, (const char*)(*Value), Value.NumBytesWithoutNull());
+			PushFString(State, *Value, Value.Len());
 		}
 	};
 
@@ -217,16 +221,19 @@ namespace TLua
 			OutValue = FromLua(State, Index);
 		}
 
+		// the interned string is resolved once, see NameCache
 		inline static FName FromLua(lua_State* State, int Index)
 		{
-			size_t Size = 0;
-			const TCHAR* Buffer = (const TCHAR*)LuaGetLString(State, Index, Size);
-			return FName(Size / sizeof(TCHAR), Buffer);
+#if TLUA_STRING_UTF8
+			return NameCache::Get().ToName(State, Index, ENameEncoding::Utf8);
+#else
+			return NameCache::Get().ToName(State, Index, ENameEncoding::Tchar);
+#endif
 		}
 
 		inline static void ToLua(lua_State* State, const FName& Value)
 		{
-			TypeInfo<FString>::ToLua(State, Value.ToString());
+			PushName(State, Value);
 		}
 	};
 
@@ -261,29 +268,27 @@ namespace TLua
 
 		inline static UObject* FromLua(lua_State* State, int Index)
 		{
-			if (!LuaIsTable(State, Index)) {
-				return (UObject*)LuaGetUserData(State, Index);
+			switch (lua_type(State, Index)) {
+			case LUA_TUSERDATA:
+				return GetProxyObject(State, Index);
+			case LUA_TLIGHTUSERDATA:
+				return (UObject*)lua_touserdata(State, Index);
+			case LUA_TTABLE:
+			{
+				// the lua side object
+				LuaGetField(State, Index, "_co");
+				UObject* Result = (UObject*)LuaGetUserData(State, -1);
+				LuaPop(State, 1);
+				return Result;
+			}
+			default:
+				return nullptr;
 			}
-
-			LuaGetField(State, Index, "_co");
-			UObject* Result = (UObject*)LuaGetUserData(State, -1);
-			LuaPop(State, 1);
-
-			return Result;
 		}
 
 		inline static void ToLua(lua_State* State, const UObject* Value)
 		{
-			if (Value == nullptr) {
-				LuaPushNil(State);
-				return;
-			}
-
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
-			LuaGetGlobal(State, "_lua_get_obj");
-			LuaPushUserData(State, (void*)Value);
-			LuaPushUserData(State, Value->GetClass());
-			LuaPCall(State, 3, 1);
+			PushObjectProxy(State, (UObject*)Value);
 		}
 	};
 
@@ -366,11 +371,11 @@ namespace TLua
 
 		inline static void ToLua(lua_State* State, const Type& Value)
 		{
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
+			int Handler = LuaPushTraceHandler(State);
 			LuaGetGlobal(State, "_lua_get_enum");
 			LuaPushUserData(State, (void*)StaticEnum<Type>());
 			LuaPushInteger(State, (int)Value);
-			LuaPCall(State, 3, 1);
+			LuaTraceCall(State, Handler, 2, 1);
 		}
 	};
 	
@@ -382,11 +387,7 @@ namespace TLua
 
 		inline static void ToLua(lua_State* State, const Type* Value)
 		{
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
-			LuaGetGlobal(State, "_lua_get_struct");
-			LuaPushUserData(State, (void*)Value);
-			LuaPushUserData(State, (void*)TBaseStructure<Type>::Get());
-			LuaPCall(State, 3, 1);
+			PushStructRef(State, TBaseStructure<Type>::Get(), (void*)Value);
 		}
 	};
 
@@ -397,6 +398,11 @@ namespace TLua
 	{
 		inline static void FromLua(lua_State* State, int Index, Type& OutValue)
 		{
+			if (Type* Value = (Type*)GetStructValue(State, Index, TBaseStructure<Type>::Get())) {
+				OutValue = *Value;
+				return;
+			}
+
 			if (!LuaIsTable(State, Index)) {
 				return;
 			}
@@ -410,6 +416,10 @@ namespace TLua
 
 		inline static Type& FromLua(lua_State* State, int Index)
 		{
+			if (Type* Value = (Type*)GetStructValue(State, Index, TBaseStructure<Type>::Get())) {
+				return *Value;
+			}
+
 			if (!LuaIsTable(State, Index)) {
 				return Type();
 			}
@@ -423,10 +433,67 @@ namespace TLua
 
 		inline static void ToLua(lua_State* State, const Type& Value)
 		{
-			TypeInfo<Type*>::ToLua(State, &Value);
+			PushStructCopy(State, TBaseStructure<Type>::Get(), &Value);
 		}
 	};
 
+	// the math struct by value, see TLuaValueTypes.hpp
+	template <typename Type>
+	struct ValueTypeInfo
+	{
+		inline static void FromLua(lua_State* State, int Index, Type& OutValue)
+		{
+			OutValue = FromLua(State, Index);
+		}
+
+		inline static Type FromLua(lua_State* State, int Index)
+		{
+			if (Type* Value = ToValueType<Type>(State, Index)) {
+				return *Value;
+			}
+
+			// the lua side struct {_co = ...}
+			if (LuaIsTable(State, Index)) {
+				LuaGetField(State, Index, "_co");
+				Type* Value = (Type*)LuaGetUserData(State, -1);
+				LuaPop(State, 1);
+				if (Value) {
+					return *Value;
+				}
+			}
+
+			if constexpr (std::is_same_v<Type, FTransform>) {
+				return FTransform::Identity;
+			}
+			else {
+				return Type(ForceInit);
+			}
+		}
+
+		inline static void ToLua(lua_State* State, const Type& Value)
+		{
+			PushValueType(State, Value);
+		}
+	};
+
+	template <>
+	struct TypeInfo<FVector> : public ValueTypeInfo<FVector> {};
+
+	template <>
+	struct TypeInfo<FVector2D> : public ValueTypeInfo<FVector2D> {};
+
+	template <>
+	struct TypeInfo<FRotator> : public ValueTypeInfo<FRotator> {};
+
+	template <>
+	struct TypeInfo<FQuat> : public ValueTypeInfo<FQuat> {};
+
+	template <>
+	struct TypeInfo<FTransform> : public ValueTypeInfo<FTransform> {};
+
+	template <>
+	struct TypeInfo<FLinearColor> : public ValueTypeInfo<FLinearColor> {};
+
 	template <typename Type>
 	struct TypeInfo<Type, 
 		std::void_t<std::enable_if_t<std::is_base_of_v<UActorComponent, std::remove_pointer_t<Type>>>>>
@@ -439,25 +506,12 @@ namespace TLua
 
 		inline static std::remove_pointer_t<Type>* FromLua(lua_State* State, int Index)
 		{
-			LuaGetField(State, Index, "_co");
-
-			std::remove_pointer_t<Type>*  Result = (std::remove_pointer_t<Type>*)LuaGetUserData(State, -1);
-			LuaPop(State, 1);
-			return Result;
+			return Cast<std::remove_pointer_t<Type>>(TypeInfo<UObject*>::FromLua(State, Index));
 		}
 
 		inline static void ToLua(lua_State* State, const Type& Value)
 		{
-			if (!Value) {
-				LuaPushNil(State);
-				return;
-			}
-
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
-			LuaGetGlobal(State, "_lua_get_com");
-			LuaPushUserData(State, Value);
-			LuaPushUserData(State, Value->GetClass());
-			LuaPCall(State, 3, 1);
+			PushObjectProxy(State, (UObject*)Value);
 		}
 	};
 
@@ -474,25 +528,12 @@ namespace TLua
 
 		inline static std::remove_pointer_t<Type>* FromLua(lua_State* State, int Index)
 		{
-			LuaGetField(State, Index, "_co");
-			std::remove_pointer_t<Type>* Result = (std::remove_pointer_t<Type>*)LuaGetUserData(State, -1);
-			LuaPop(State, 1);
-
-			return Result;
+			return Cast<std::remove_pointer_t<Type>>(TypeInfo<UObject*>::FromLua(State, Index));
 		}
 
 		inline static void ToLua(lua_State* State, const Type& Value)
 		{
-			if (!Value) {
-				LuaPushNil(State);
-				return;
-			}
-
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
-			LuaGetGlobal(State, "_lua_get_actor");
-			LuaPushUserData(State, Value);
-			LuaPushUserData(State, Value->GetClass());
-			LuaPCall(State, 3, 1);
+			PushObjectProxy(State, (UObject*)Value);
 		}
 	};
 
@@ -540,10 +581,10 @@ namespace TLua
 
 		inline static void ToLua(lua_State* State, const FScriptDelegate* Delegate)
 		{
-			LuaGetGlobal(State, TLUA_TRACE_CALL_NAME);
+			int Handler = LuaPushTraceHandler(State);
 			LuaGetGlobal(State, "_lua_get_delegate");
 			LuaPushUserData(State, (void*)Delegate);
-			LuaPCall(State, 2, 1);
+			LuaTraceCall(State, Handler, 1, 1);
 		}
 	};
 }
\ No newline at end of file
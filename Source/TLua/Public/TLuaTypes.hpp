@@ -27,6 +27,10 @@ namespace TLua
 		TypeInfo<Type>::ToLua(State, Value);
 	}
 
+	inline void PushValues(lua_State* State)
+	{
+	}
+
 	template <typename Type>
 	inline void PushValues(lua_State* State, const Type& Arg)
 	{
@@ -0,0 +1,627 @@
+#include "TLuaValueTypes.hpp"
+
+#include <cstring>
+#include <type_traits>
+
+#include "TLua.h"
+
+namespace TLua
+{
+	// registry[&MetatablesKey] = { [UScriptStruct*] = metatable }
+	static char MetatablesKey;
+	// metatable[&ValueTypeTag] = UScriptStruct*
+	static char ValueTypeTag;
+
+	// the structs have a value metatable
+	static TSet<const UScriptStruct*> ValueStructs;
+
+	// lua only aligns the userdata to LUAI_MAXALIGN, the SIMD types (FQuat, FTransform)
+	// need more, they are allocated with alignment - 1 bytes more and the value is at
+	// the aligned address. Align is a no-op on the userdata of the other types
+	union LuaMaxAlign { LUAI_MAXALIGN; };
+
+	static inline SIZE_T GetValueAlignment(const UScriptStruct* Struct)
+	{
+		return (SIZE_T)FMath::Max(Struct->GetMinAlignment(), 1);
+	}
+
+	static inline SIZE_T GetValuePadding(SIZE_T Alignment)
+	{
+		return Alignment > alignof(LuaMaxAlign) ? Alignment - 1 : 0;
+	}
+
+	static inline uint8* AlignValue(void* Block, SIZE_T Alignment)
+	{
+		return Align((uint8*)Block, Alignment);
+	}
+
+	void* NewValue(lua_State* State, const UScriptStruct* Struct)
+	{
+		lua_rawgetp(State, LUA_REGISTRYINDEX, &MetatablesKey);		// metatables
+		if (lua_rawgetp(State, -1, Struct) != LUA_TTABLE) {			// metatables, mt
+			lua_pop(State, 2);
+			return nullptr;
+		}
+
+		SIZE_T Alignment = GetValueAlignment(Struct);
+		void* Block = lua_newuserdatauv(State, Struct->GetStructureSize() + GetValuePadding(Alignment), 0);
+		lua_insert(State, -3);										// value, metatables, mt
+		lua_setmetatable(State, -3);								// value, metatables
+		lua_pop(State, 1);											// value
+
+		return AlignValue(Block, Alignment);
+	}
+
+	void* ToValue(lua_State* State, int Index, const UScriptStruct* Struct)
+	{
+		if (lua_type(State, Index) != LUA_TUSERDATA || !lua_getmetatable(State, Index)) {
+			return nullptr;
+		}
+
+		lua_rawgetp(State, -1, &ValueTypeTag);
+		bool Match = lua_touserdata(State, -1) == Struct;
+		lua_pop(State, 2);
+
+		return Match ? AlignValue(lua_touserdata(State, Index), GetValueAlignment(Struct)) : nullptr;
+	}
+
+	bool IsValueStruct(const UScriptStruct* Struct)
+	{
+		return ValueStructs.Contains(Struct);
+	}
+
+	template <typename Type>
+	struct ValueName {};
+
+#define TLUA_VALUE_NAME(Type) \
+	template <> struct ValueName<Type> { static constexpr const char* Get() { return #Type; } };
+
+	TLUA_VALUE_NAME(FVector)
+	TLUA_VALUE_NAME(FVector2D)
+	TLUA_VALUE_NAME(FRotator)
+	TLUA_VALUE_NAME(FQuat)
+	TLUA_VALUE_NAME(FTransform)
+	TLUA_VALUE_NAME(FLinearColor)
+
+#undef TLUA_VALUE_NAME
+
+	// the number member of the value, read and written by __index/__newindex
+	struct ValueField
+	{
+		const char* Name;
+		int32 Offset;
+		bool bFloat;
+	};
+
+#define TLUA_VALUE_FIELD(Type, Member) \
+	{ #Member, (int32)STRUCT_OFFSET(Type, Member), std::is_same_v<std::decay_t<decltype(((Type*)nullptr)->Member)>, float> }
+
+	static const ValueField VectorFields[] = {
+		TLUA_VALUE_FIELD(FVector, X), TLUA_VALUE_FIELD(FVector, Y), TLUA_VALUE_FIELD(FVector, Z), { nullptr, 0, false }
+	};
+	static const ValueField Vector2DFields[] = {
+		TLUA_VALUE_FIELD(FVector2D, X), TLUA_VALUE_FIELD(FVector2D, Y), { nullptr, 0, false }
+	};
+	static const ValueField RotatorFields[] = {
+		TLUA_VALUE_FIELD(FRotator, Pitch), TLUA_VALUE_FIELD(FRotator, Yaw), TLUA_VALUE_FIELD(FRotator, Roll), { nullptr, 0, false }
+	};
+	static const ValueField QuatFields[] = {
+		TLUA_VALUE_FIELD(FQuat, X), TLUA_VALUE_FIELD(FQuat, Y), TLUA_VALUE_FIELD(FQuat, Z), TLUA_VALUE_FIELD(FQuat, W), { nullptr, 0, false }
+	};
+	// the members of FTransform may be vector registers, use the methods
+	static const ValueField TransformFields[] = {
+		{ nullptr, 0, false }
+	};
+	static const ValueField LinearColorFields[] = {
+		TLUA_VALUE_FIELD(FLinearColor, R), TLUA_VALUE_FIELD(FLinearColor, G), TLUA_VALUE_FIELD(FLinearColor, B), TLUA_VALUE_FIELD(FLinearColor, A), { nullptr, 0, false }
+	};
+
+#undef TLUA_VALUE_FIELD
+
+	static const ValueField* FindField(const ValueField* Fields, const char* Name)
+	{
+		for (const ValueField* Field = Fields; Field->Name; ++Field) {
+			if (std::strcmp(Field->Name, Name) == 0) {
+				return Field;
+			}
+		}
+		return nullptr;
+	}
+
+	template <typename Type>
+	static Type& CheckValue(lua_State* State, int Index)
+	{
+		Type* Value = ToValueType<Type>(State, Index);
+		if (!Value) {
+			luaL_typeerror(State, Index, ValueName<Type>::Get());
+		}
+		return *Value;
+	}
+
+	// __index(value, key), upvalues: fields, methods, alignment
+	static int ValueIndex(lua_State* State)
+	{
+		if (lua_type(State, 2) == LUA_TSTRING) {
+			const ValueField* Fields = (const ValueField*)lua_touserdata(State, lua_upvalueindex(1));
+			const ValueField* Field = FindField(Fields, lua_tostring(State, 2));
+			if (Field) {
+				SIZE_T Alignment = (SIZE_T)lua_tointeger(State, lua_upvalueindex(3));
+				const uint8* Value = AlignValue(lua_touserdata(State, 1), Alignment) + Field->Offset;
+				lua_pushnumber(State, Field->bFloat ? *(const float*)Value : *(const double*)Value);
+				return 1;
+			}
+		}
+
+		lua_pushvalue(State, 2);
+		lua_rawget(State, lua_upvalueindex(2));
+		return 1;
+	}
+
+	// __newindex(value, key, number), upvalues: fields, alignment
+	static int ValueNewIndex(lua_State* State)
+	{
+		const ValueField* Fields = (const ValueField*)lua_touserdata(State, lua_upvalueindex(1));
+		const char* Name = luaL_checkstring(State, 2);
+		const ValueField* Field = FindField(Fields, Name);
+		if (!Field) {
+			return luaL_error(State, "no field %s in %s", Name, luaL_typename(State, 1));
+		}
+
+		SIZE_T Alignment = (SIZE_T)lua_tointeger(State, lua_upvalueindex(2));
+		uint8* Value = AlignValue(lua_touserdata(State, 1), Alignment) + Field->Offset;
+		lua_Number Number = luaL_checknumber(State, 3);
+		if (Field->bFloat) {
+			*(float*)Value = (float)Number;
+		}
+		else {
+			*(double*)Value = (double)Number;
+		}
+		return 0;
+	}
+
+	template <typename Type>
+	static int ValueToString(lua_State* State)
+	{
+		FTCHARToUTF8 Convert(*CheckValue<Type>(State, 1).ToString());
+		lua_pushlstring(State, (const char*)Convert.Get(), Convert.Length());
+		return 1;
+	}
+
+	template <typename Type>
+	static int ValueEq(lua_State* State)
+	{
+		Type* A = ToValueType<Type>(State, 1);
+		Type* B = ToValueType<Type>(State, 2);
+		lua_pushboolean(State, A && B && A->Equals(*B, 0));
+		return 1;
+	}
+
+	// value:Copy() -> value
+	template <typename Type>
+	static int ValueCopy(lua_State* State)
+	{
+		PushValueType(State, Type(CheckValue<Type>(State, 1)));
+		return 1;
+	}
+
+	template <typename Type>
+	static int ValueAdd(lua_State* State)
+	{
+		PushValueType(State, Type(CheckValue<Type>(State, 1) + CheckValue<Type>(State, 2)));
+		return 1;
+	}
+
+	template <typename Type>
+	static int ValueSub(lua_State* State)
+	{
+		PushValueType(State, Type(CheckValue<Type>(State, 1) - CheckValue<Type>(State, 2)));
+		return 1;
+	}
+
+	template <typename Type>
+	static int ValueUnm(lua_State* State)
+	{
+		PushValueType(State, Type(-CheckValue<Type>(State, 1)));
+		return 1;
+	}
+
+	// value * number, number * value, value * value (component wise)
+	template <typename Type, typename ScaleType, bool bComponentWise>
+	static int ValueMul(lua_State* State)
+	{
+		if (lua_type(State, 1) == LUA_TNUMBER) {
+			PushValueType(State, Type(CheckValue<Type>(State, 2) * (ScaleType)lua_tonumber(State, 1)));
+		}
+		else if (lua_type(State, 2) == LUA_TNUMBER) {
+			PushValueType(State, Type(CheckValue<Type>(State, 1) * (ScaleType)lua_tonumber(State, 2)));
+		}
+		else if constexpr (bComponentWise) {
+			PushValueType(State, Type(CheckValue<Type>(State, 1) * CheckValue<Type>(State, 2)));
+		}
+		else {
+			luaL_typeerror(State, 2, "number");
+		}
+		return 1;
+	}
+
+	template <typename Type, typename ScaleType>
+	static int ValueDiv(lua_State* State)
+	{
+		Type& Value = CheckValue<Type>(State, 1);
+		PushValueType(State, Type(Value / (ScaleType)luaL_checknumber(State, 2)));
+		return 1;
+	}
+
+	// quat * quat, quat * vector
+	static int QuatMul(lua_State* State)
+	{
+		FQuat& Quat = CheckValue<FQuat>(State, 1);
+		if (FVector* Vector = ToValueType<FVector>(State, 2)) {
+			PushValueType(State, Quat.RotateVector(*Vector));
+			return 1;
+		}
+
+		PushValueType(State, FQuat(Quat * CheckValue<FQuat>(State, 2)));
+		return 1;
+	}
+
+	static int TransformMul(lua_State* State)
+	{
+		PushValueType(State, FTransform(CheckValue<FTransform>(State, 1) * CheckValue<FTransform>(State, 2)));
+		return 1;
+	}
+
+	// vector methods
+	static int VectorSize(lua_State* State)
+	{
+		lua_pushnumber(State, CheckValue<FVector>(State, 1).Size());
+		return 1;
+	}
+
+	static int VectorSizeSquared(lua_State* State)
+	{
+		lua_pushnumber(State, CheckValue<FVector>(State, 1).SizeSquared());
+		return 1;
+	}
+
+	static int VectorGetSafeNormal(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FVector>(State, 1).GetSafeNormal());
+		return 1;
+	}
+
+	static int VectorDot(lua_State* State)
+	{
+		lua_pushnumber(State, CheckValue<FVector>(State, 1) | CheckValue<FVector>(State, 2));
+		return 1;
+	}
+
+	static int VectorCross(lua_State* State)
+	{
+		PushValueType(State, FVector(CheckValue<FVector>(State, 1) ^ CheckValue<FVector>(State, 2)));
+		return 1;
+	}
+
+	static int VectorRotation(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FVector>(State, 1).Rotation());
+		return 1;
+	}
+
+	// vector2d methods
+	static int Vector2DSize(lua_State* State)
+	{
+		lua_pushnumber(State, CheckValue<FVector2D>(State, 1).Size());
+		return 1;
+	}
+
+	static int Vector2DGetSafeNormal(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FVector2D>(State, 1).GetSafeNormal());
+		return 1;
+	}
+
+	static int Vector2DDot(lua_State* State)
+	{
+		lua_pushnumber(State, CheckValue<FVector2D>(State, 1) | CheckValue<FVector2D>(State, 2));
+		return 1;
+	}
+
+	// rotator methods
+	static int RotatorVector(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FRotator>(State, 1).Vector());
+		return 1;
+	}
+
+	static int RotatorQuaternion(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FRotator>(State, 1).Quaternion());
+		return 1;
+	}
+
+	static int RotatorGetNormalized(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FRotator>(State, 1).GetNormalized());
+		return 1;
+	}
+
+	static int RotatorRotateVector(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FRotator>(State, 1).RotateVector(CheckValue<FVector>(State, 2)));
+		return 1;
+	}
+
+	// quat methods
+	static int QuatRotator(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FQuat>(State, 1).Rotator());
+		return 1;
+	}
+
+	static int QuatInverse(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FQuat>(State, 1).Inverse());
+		return 1;
+	}
+
+	static int QuatRotateVector(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FQuat>(State, 1).RotateVector(CheckValue<FVector>(State, 2)));
+		return 1;
+	}
+
+	static int QuatUnrotateVector(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FQuat>(State, 1).UnrotateVector(CheckValue<FVector>(State, 2)));
+		return 1;
+	}
+
+	// transform methods
+	static int TransformGetLocation(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FTransform>(State, 1).GetLocation());
+		return 1;
+	}
+
+	static int TransformGetRotation(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FTransform>(State, 1).GetRotation());
+		return 1;
+	}
+
+	static int TransformGetScale3D(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FTransform>(State, 1).GetScale3D());
+		return 1;
+	}
+
+	static int TransformSetLocation(lua_State* State)
+	{
+		CheckValue<FTransform>(State, 1).SetLocation(CheckValue<FVector>(State, 2));
+		return 0;
+	}
+
+	static int TransformSetRotation(lua_State* State)
+	{
+		CheckValue<FTransform>(State, 1).SetRotation(CheckValue<FQuat>(State, 2));
+		return 0;
+	}
+
+	static int TransformSetScale3D(lua_State* State)
+	{
+		CheckValue<FTransform>(State, 1).SetScale3D(CheckValue<FVector>(State, 2));
+		return 0;
+	}
+
+	static int TransformTransformPosition(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FTransform>(State, 1).TransformPosition(CheckValue<FVector>(State, 2)));
+		return 1;
+	}
+
+	static int TransformInverseTransformPosition(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FTransform>(State, 1).InverseTransformPosition(CheckValue<FVector>(State, 2)));
+		return 1;
+	}
+
+	static int TransformInverse(lua_State* State)
+	{
+		PushValueType(State, CheckValue<FTransform>(State, 1).Inverse());
+		return 1;
+	}
+
+	static const luaL_Reg VectorMetamethods[] = {
+		{ "__add", ValueAdd<FVector> },
+		{ "__sub", ValueSub<FVector> },
+		{ "__mul", ValueMul<FVector, double, true> },
+		{ "__div", ValueDiv<FVector, double> },
+		{ "__unm", ValueUnm<FVector> },
+		{ nullptr, nullptr }
+	};
+	static const luaL_Reg VectorMethods[] = {
+		{ "Size", VectorSize },
+		{ "SizeSquared", VectorSizeSquared },
+		{ "GetSafeNormal", VectorGetSafeNormal },
+		{ "Dot", VectorDot },
+		{ "Cross", VectorCross },
+		{ "Rotation", VectorRotation },
+		{ nullptr, nullptr }
+	};
+
+	static const luaL_Reg Vector2DMetamethods[] = {
+		{ "__add", ValueAdd<FVector2D> },
+		{ "__sub", ValueSub<FVector2D> },
+		{ "__mul", ValueMul<FVector2D, double, true> },
+		{ "__div", ValueDiv<FVector2D, double> },
+		{ "__unm", ValueUnm<FVector2D> },
+		{ nullptr, nullptr }
+	};
+	static const luaL_Reg Vector2DMethods[] = {
+		{ "Size", Vector2DSize },
+		{ "GetSafeNormal", Vector2DGetSafeNormal },
+		{ "Dot", Vector2DDot },
+		{ nullptr, nullptr }
+	};
+
+	static const luaL_Reg RotatorMetamethods[] = {
+		{ "__add", ValueAdd<FRotator> },
+		{ "__sub", ValueSub<FRotator> },
+		{ "__mul", ValueMul<FRotator, double, false> },
+		{ nullptr, nullptr }
+	};
+	static const luaL_Reg RotatorMethods[] = {
+		{ "Vector", RotatorVector },
+		{ "Quaternion", RotatorQuaternion },
+		{ "GetNormalized", RotatorGetNormalized },
+		{ "RotateVector", RotatorRotateVector },
+		{ nullptr, nullptr }
+	};
+
+	static const luaL_Reg QuatMetamethods[] = {
+		{ "__mul", QuatMul },
+		{ nullptr, nullptr }
+	};
+	static const luaL_Reg QuatMethods[] = {
+		{ "Rotator", QuatRotator },
+		{ "Inverse", QuatInverse },
+		{ "RotateVector", QuatRotateVector },
+		{ "UnrotateVector", QuatUnrotateVector },
+		{ nullptr, nullptr }
+	};
+
+	static const luaL_Reg TransformMetamethods[] = {
+		{ "__mul", TransformMul },
+		{ nullptr, nullptr }
+	};
+	static const luaL_Reg TransformMethods[] = {
+		{ "GetLocation", TransformGetLocation },
+		{ "GetRotation", TransformGetRotation },
+		{ "GetScale3D", TransformGetScale3D },
+		{ "SetLocation", TransformSetLocation },
+		{ "SetRotation", TransformSetRotation },
+		{ "SetScale3D", TransformSetScale3D },
+		{ "TransformPosition", TransformTransformPosition },
+		{ "InverseTransformPosition", TransformInverseTransformPosition },
+		{ "Inverse", TransformInverse },
+		{ nullptr, nullptr }
+	};
+
+	static const luaL_Reg LinearColorMetamethods[] = {
+		{ "__add", ValueAdd<FLinearColor> },
+		{ "__sub", ValueSub<FLinearColor> },
+		{ "__mul", ValueMul<FLinearColor, float, true> },
+		{ "__div", ValueDiv<FLinearColor, float> },
+		{ nullptr, nullptr }
+	};
+	static const luaL_Reg LinearColorMethods[] = {
+		{ nullptr, nullptr }
+	};
+
+	// stack: metatables -> metatables
+	template <typename Type>
+	static void NewValueMetatable(lua_State* State, const ValueField* Fields,
+		const luaL_Reg* Metamethods, const luaL_Reg* Methods)
+	{
+		UScriptStruct* Struct = TBaseStructure<Type>::Get();
+		check(GetValueAlignment(Struct) >= alignof(Type));
+
+		lua_newtable(State);										// metatables, mt
+		luaL_setfuncs(State, Metamethods, 0);
+
+		lua_pushstring(State, ValueName<Type>::Get());
+		lua_setfield(State, -2, "__name");
+		lua_pushlightuserdata(State, Struct);
+		lua_rawsetp(State, -2, &ValueTypeTag);
+		lua_pushcfunction(State, ValueToString<Type>);
+		lua_setfield(State, -2, "__tostring");
+		lua_pushcfunction(State, ValueEq<Type>);
+		lua_setfield(State, -2, "__eq");
+
+		lua_pushlightuserdata(State, (void*)Fields);				// metatables, mt, fields
+		lua_newtable(State);										// metatables, mt, fields, methods
+		luaL_setfuncs(State, Methods, 0);
+		lua_pushcfunction(State, ValueCopy<Type>);
+		lua_setfield(State, -2, "Copy");
+		lua_pushinteger(State, (lua_Integer)GetValueAlignment(Struct));
+		lua_pushcclosure(State, ValueIndex, 3);						// metatables, mt, __index
+		lua_setfield(State, -2, "__index");
+
+		lua_pushlightuserdata(State, (void*)Fields);
+		lua_pushinteger(State, (lua_Integer)GetValueAlignment(Struct));
+		lua_pushcclosure(State, ValueNewIndex, 2);
+		lua_setfield(State, -2, "__newindex");
+
+		lua_rawsetp(State, -2, Struct);								// metatables
+		ValueStructs.Add(Struct);
+	}
+
+	// _cpp_make_vector2d(x, y) -> FVector2D
+	static int CppMakeVector2D(lua_State* State)
+	{
+		PushValueType(State, FVector2D(lua_tonumber(State, 1), lua_tonumber(State, 2)));
+		return 1;
+	}
+
+	// _cpp_make_rotator(pitch, yaw, roll) -> FRotator
+	static int CppMakeRotator(lua_State* State)
+	{
+		PushValueType(State, FRotator(lua_tonumber(State, 1), lua_tonumber(State, 2), lua_tonumber(State, 3)));
+		return 1;
+	}
+
+	// _cpp_make_quat(x, y, z, w) -> FQuat
+	static int CppMakeQuat(lua_State* State)
+	{
+		PushValueType(State, FQuat(lua_tonumber(State, 1), lua_tonumber(State, 2),
+			lua_tonumber(State, 3), lua_tonumber(State, 4)));
+		return 1;
+	}
+
+	// _cpp_make_transform(rotation, location, scale) -> FTransform
+	// rotation: FQuat | FRotator | nil
+	static int CppMakeTransform(lua_State* State)
+	{
+		FQuat Rotation = FQuat::Identity;
+		if (FQuat* Quat = ToValueType<FQuat>(State, 1)) {
+			Rotation = *Quat;
+		}
+		else if (FRotator* Rotator = ToValueType<FRotator>(State, 1)) {
+			Rotation = Rotator->Quaternion();
+		}
+
+		FVector* Location = ToValueType<FVector>(State, 2);
+		FVector* Scale = ToValueType<FVector>(State, 3);
+
+		PushValueType(State, FTransform(Rotation,
+			Location ? *Location : FVector::ZeroVector, Scale ? *Scale : FVector::OneVector));
+		return 1;
+	}
+
+	// _cpp_make_color(r, g, b, a) -> FLinearColor
+	static int CppMakeColor(lua_State* State)
+	{
+		PushValueType(State, FLinearColor((float)lua_tonumber(State, 1), (float)lua_tonumber(State, 2),
+			(float)lua_tonumber(State, 3), (float)luaL_optnumber(State, 4, 1.0)));
+		return 1;
+	}
+
+	void RegisterValueTypes(lua_State* State)
+	{
+		lua_newtable(State);										// metatables
+		NewValueMetatable<FVector>(State, VectorFields, VectorMetamethods, VectorMethods);
+		NewValueMetatable<FVector2D>(State, Vector2DFields, Vector2DMetamethods, Vector2DMethods);
+		NewValueMetatable<FRotator>(State, RotatorFields, RotatorMetamethods, RotatorMethods);
+		NewValueMetatable<FQuat>(State, QuatFields, QuatMetamethods, QuatMethods);
+		NewValueMetatable<FTransform>(State, TransformFields, TransformMetamethods, TransformMethods);
+		NewValueMetatable<FLinearColor>(State, LinearColorFields, LinearColorMetamethods, LinearColorMethods);
+		lua_rawsetp(State, LUA_REGISTRYINDEX, &MetatablesKey);
+
+		lua_register(State, "_cpp_make_vector2d", CppMakeVector2D);
+		lua_register(State, "_cpp_make_rotator", CppMakeRotator);
+		lua_register(State, "_cpp_make_quat", CppMakeQuat);
+		lua_register(State, "_cpp_make_transform", CppMakeTransform);
+		lua_register(State, "_cpp_make_color", CppMakeColor);
+	}
+}
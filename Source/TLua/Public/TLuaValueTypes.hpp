@@ -0,0 +1,37 @@
+#pragma once
+
+#include <new>
+
+#include "Lua/lua.hpp"
+
+#include "CoreMinimal.h"
+#include "UObject/Class.h"
+
+namespace TLua
+{
+	// the math structs (FVector, FVector2D, FRotator, FQuat, FTransform, FLinearColor)
+	// live in lua as inline userdata by value, no __gc.
+	// every type shares one metatable with the native operators and fields.
+
+	// push a new value of the struct, return the memory to construct it, nullptr if it's not a value type
+	TLua_API void* NewValue(lua_State* State, const UScriptStruct* Struct);
+
+	// return the value at the index, nullptr if it's not a value of the struct
+	TLua_API void* ToValue(lua_State* State, int Index, const UScriptStruct* Struct);
+
+	TLua_API bool IsValueStruct(const UScriptStruct* Struct);
+
+	template <typename Type>
+	inline void PushValueType(lua_State* State, const Type& Value)
+	{
+		new (NewValue(State, TBaseStructure<Type>::Get())) Type(Value);
+	}
+
+	template <typename Type>
+	inline Type* ToValueType(lua_State* State, int Index)
+	{
+		return (Type*)ToValue(State, Index, TBaseStructure<Type>::Get());
+	}
+
+	void RegisterValueTypes(lua_State* State);
+}